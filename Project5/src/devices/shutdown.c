@@ -12,6 +12,13 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
+#include "filesys/cache.h"
+#include "filesys/inode.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
+#endif
+#ifdef VM
+#include "vm/vm_util.h"
 #endif
 
 /* Keyboard control register port. */
@@ -132,10 +139,17 @@ print_stats (void)
   thread_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  cache_print_stats ();
+  inode_print_stats ();
+  dcache_print_stats ();
+  journal_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  vm_print_stats ();
+#endif
 }
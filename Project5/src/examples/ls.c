@@ -36,11 +36,7 @@ list_dir (const char *dir, bool verbose)
           printf ("%s", name); 
           if (verbose) 
             {
-              char full_name[128];
-              int entry_fd;
-
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
+              int entry_fd = openat (dir_fd, name);
 
               printf (": ");
               if (entry_fd != -1)
@@ -1,21 +1,65 @@
 /* rm.c
 
-   Removes files specified on command line. */
+   Removes files specified on command line.  With "-r" as the
+   first argument, also removes directories and everything in
+   them. */
 
 #include <stdio.h>
+#include <string.h>
 #include <syscall.h>
 
+/* Removes everything in the directory open as DIR_FD, names
+   relative to it, so that the path is not resolved again for
+   every entry.  Returns true if successful. */
+static bool
+remove_contents (int dir_fd) 
+{
+  char name[READDIR_MAX_LEN + 1];
+  bool success = true;
+
+  while (readdir (dir_fd, name)) 
+    {
+      int fd = openat (dir_fd, name);
+      if (fd != -1 && isdir (fd) && !remove_contents (fd))
+        success = false;
+      close (fd);
+      if (!removeat (dir_fd, name)) 
+        {
+          printf ("%s: remove failed\n", name);
+          success = false;
+        }
+    }
+  return success;
+}
+
 int
 main (int argc, char *argv[]) 
 {
   bool success = true;
+  bool recursive = false;
   int i;
+
+  if (argc > 1 && !strcmp (argv[1], "-r")) 
+    {
+      recursive = true;
+      argv++;
+      argc--;
+    }
   
-  for (i = 1; i < argc; i++)
-    if (!remove (argv[i])) 
-      {
-        printf ("%s: remove failed\n", argv[i]);
-        success = false; 
-      }
+  for (i = 1; i < argc; i++) 
+    {
+      if (recursive) 
+        {
+          int fd = open (argv[i]);
+          if (fd != -1 && isdir (fd) && !remove_contents (fd))
+            success = false;
+          close (fd);
+        }
+      if (!remove (argv[i])) 
+        {
+          printf ("%s: remove failed\n", argv[i]);
+          success = false; 
+        }
+    }
   return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
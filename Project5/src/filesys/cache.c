@@ -3,149 +3,498 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #include "devices/timer.h"
+#include <stdlib.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include <stdio.h>
+#include <string.h>
 
 
 static struct cache cache;
 
-static unsigned sectors_hash(const struct hash_elem *e, void *aux UNUSED)
-{
-	struct sector *sec = hash_entry(e, struct sector, hash_elem);
-	return sec->index;
+static void mark_dirty(struct sector *sec);
+static void mark_clean(struct sector *sec);
+
+static struct cache_bucket * sector_bucket(block_sector_t index) {
+	return (cache.buckets + (index % CACHE_BUCKET_COUNT));
+}
+
+/* Returns the slot, that holds sector INDEX in BUCKET, or NULL.
+   Bucket lock has to be held. */
+static struct sector * bucket_find(struct cache_bucket *bucket, block_sector_t index) {
+	struct list_elem *e;
+	for (e = list_begin(&bucket->sectors); e != list_end(&bucket->sectors); e = list_next(e)) {
+		struct sector *sec = list_entry(e, struct sector, bucket_elem);
+		if (sec->index == index) return sec;
+	}
+	return NULL;
+}
+
+/* Returns true, if SEC is a valid member of BUCKET. Bucket lock has to be held;
+   any slot, that is not in the bucket, can change under our feet, but it can never
+   pretend to be valid in a bucket we are holding. */
+static bool sector_in_bucket(struct sector *sec, struct cache_bucket *bucket) {
+	return (sec->state != SECTOR_FREE && sector_bucket(sec->index) == bucket);
+}
+
+/* Disk write of a sector, that is not cached; see cache_write_through(). */
+struct bypass_write {
+	block_sector_t index;
+	struct list_elem elem;
+};
+
+/* Returns true, if sector INDEX is being written past the cache. Bucket lock has to be held. */
+static bool bypass_pending(struct cache_bucket *bucket, block_sector_t index) {
+	struct list_elem *e;
+	for (e = list_begin(&bucket->bypass); e != list_end(&bucket->bypass); e = list_next(e))
+		if (list_entry(e, struct bypass_write, elem)->index == index) return true;
+	return false;
 }
-
-static void write_behind(void *arg UNUSED) { 
-    while (true){
-        timer_sleep(WRITE_BEHIND_SLEEP_TICKS); 
-        sector_cache_flush(false); 
-    }
-}
 
-static bool sectors_map_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
-	ASSERT(!aux);
-	struct sector *sector_a = hash_entry(a, struct sector, hash_elem);
-	struct sector *sector_b = hash_entry(b, struct sector, hash_elem);
-	return ((unsigned)sector_a->index < (unsigned)sector_b->index);
+static void write_behind(void *arg UNUSED) {
+    while (true){
+        timer_sleep(WRITE_BEHIND_SLEEP_TICKS);
+        sector_cache_flush();
+    }
 }
 
 void sector_init(struct sector *sec)
 {
 	sec->index = (block_sector_t)(-1);
+	sec->state = SECTOR_FREE;
+	sec->dirty = false;
+	sec->writing = false;
+	sec->pinned = false;
 	sec->owners = 0;
+	sec->usage = 0;
 	lock_init(&sec->sector_lock);
-	lock_init(&sec->owners_lock);
 }
 
-void cache_init(void) {
-	lock_init(&cache.cache_lock);
-	sema_init(&cache.cache_sem, SECTOR_COUNT);
-	hash_init(&cache.index_sectors_map, sectors_hash, sectors_map_less, NULL);
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+void cache_init(size_t sector_cnt) {
+	ASSERT(sector_cnt >= CACHE_MIN_SECTOR_COUNT);
+	cache.sector_cnt = sector_cnt;
+	cache.sectors = malloc(sizeof(struct sector) * sector_cnt);
+	if (cache.sectors == NULL)
+		PANIC("Unable to allocate buffer cache of %zu sectors", sector_cnt);
+	lock_init(&cache.evict_lock);
+	sema_init(&cache.cache_sem, sector_cnt);
 	list_init(&cache.free_list);
+	lock_init(&cache.dirty_lock);
+	list_init(&cache.dirty_list);
+	cache.dirty_cnt = 0;
 	unsigned int i;
-	for (i = 0; i < SECTOR_COUNT; i++) {
+	for (i = 0; i < CACHE_BUCKET_COUNT; i++) {
+		lock_init(&cache.buckets[i].lock);
+		cond_init(&cache.buckets[i].state_changed);
+		list_init(&cache.buckets[i].sectors);
+		list_init(&cache.buckets[i].bypass);
+		cache.buckets[i].hits = 0;
+		cache.buckets[i].misses = 0;
+		cache.buckets[i].evictions = 0;
+		cache.buckets[i].prefetches = 0;
+		cache.buckets[i].bypasses = 0;
+	}
+	char *page = NULL;
+	for (i = 0; i < sector_cnt; i++) {
+		if (i % SECTORS_PER_PAGE == 0)
+			page = palloc_get_page(PAL_ASSERT);
 		sector_init(cache.sectors + i);
+		cache.sectors[i].data = page + (i % SECTORS_PER_PAGE) * BLOCK_SECTOR_SIZE;
 		list_push_back(&cache.free_list, &cache.sectors[i].list_elem);
 	}
     tid_t tid = thread_create("write-behind", PRI_DEFAULT, write_behind, NULL);
     ASSERT (tid);
 }
 
-static uint32_t clock_hand = 0;
-static void evict_sector(void) {
-	uint32_t end = clock_hand;
+/* Returns the number of slots in the cache. */
+size_t cache_sector_count(void) {
+	return cache.sector_cnt;
+}
+
+/* Tries to detach the sector in CUR from the cache, so that the slot can be reused.
+   Slots, that were referenced since the last sweep, get another chance instead.
+   Called with evict_lock held; releases it, if (and only if) the slot was taken. */
+static bool evict_sector(struct sector *cur) {
+	struct cache_bucket *bucket = sector_bucket(cur->index);
+	lock_acquire(&bucket->lock);
+	if (!sector_in_bucket(cur, bucket) || cur->state != SECTOR_VALID || cur->owners > 0 || cur->writing
+			|| cur->pinned) {
+		lock_release(&bucket->lock);
+		return false;
+	}
+	if (cur->usage > 0) {
+		cur->usage--;
+		lock_release(&bucket->lock);
+		return false;
+	}
+	bucket->evictions++;
+	if (cur->dirty) {
+		/* Others, looking for this sector, will wait for the write to finish and retry. */
+		cur->state = SECTOR_EVICTING;
+		mark_clean(cur);
+		lock_release(&bucket->lock);
+		lock_release(&cache.evict_lock);
+		block_write(fs_device, cur->index, cur->data);
+		lock_acquire(&bucket->lock);
+	}
+	else lock_release(&cache.evict_lock);
+	list_remove(&cur->bucket_elem);
+	cur->state = SECTOR_FREE;
+	cur->index = (block_sector_t)(-1);
+	cond_broadcast(&bucket->state_changed, &bucket->lock);
+	lock_release(&bucket->lock);
+	return true;
+}
+
+/* Returns a slot, that is not part of any bucket.
+   Caller has to own a token of cache_sem, which guarantees, that such slot exists.
+   Victim is chosen by the clock hand, that ages the usage counters of the slots
+   it passes (generalized second chance); the sectors, that were read only once
+   (like the ones of a sequential scan), are thus evicted long before the inode
+   and index sectors, which are referenced over and over again. */
+static size_t clock_hand = 0;
+static struct sector * claim_slot(void) {
+	lock_acquire(&cache.evict_lock);
+	if (!list_empty(&cache.free_list)) {
+		struct sector *res = list_entry(list_pop_front(&cache.free_list), struct sector, list_elem);
+		lock_release(&cache.evict_lock);
+		return res;
+	}
+	size_t passed = 0;
 	while (true) {
-		struct sector * cur = (cache.sectors + clock_hand);
-		if (cur->index != (block_sector_t)(-1)) {
-			if (cur->owners == 0) {
-				if (cur->dirty)
-					block_write(fs_device, cur->index, cur->data);
-				hash_delete(&cache.index_sectors_map, &cur->hash_elem);
-				list_push_back(&cache.free_list, &cur->list_elem);
-				cur->index = (block_sector_t)(-1);
-				return;
-			}
-		}
-		clock_hand = ((clock_hand + 1) % SECTOR_COUNT);
-		if (clock_hand == end) break;
+		struct sector *cur = (cache.sectors + clock_hand);
+		clock_hand = ((clock_hand + 1) % cache.sector_cnt);
+		if (evict_sector(cur)) return cur;
+		/* Every candidate is being written right now; let the writers finish. */
+		passed++;
+		if (passed % (cache.sector_cnt * (CACHE_MAX_USAGE + 1)) == 0) thread_yield();
 	}
-	PANIC("WELL... THIS SHOULD NOT HAPPEN...\n");
 }
 
+/* Puts unused slot back on the free list. */
+static void unclaim_slot(struct sector *sec) {
+	lock_acquire(&cache.evict_lock);
+	list_push_front(&cache.free_list, &sec->list_elem);
+	lock_release(&cache.evict_lock);
+}
+
+/* Puts SLOT into BUCKET as sector INDEX with a single owner and reads it from the disk.
+   Bucket lock has to be held; it is released for the duration of the read. */
+static void load_sector(struct cache_bucket *bucket, struct sector *slot, block_sector_t index) {
+	slot->index = index;
+	slot->state = SECTOR_LOADING;
+	slot->dirty = false;
+	slot->pinned = false;
+	slot->owners = 1;
+	slot->usage = 0;
+	list_push_back(&bucket->sectors, &slot->bucket_elem);
+	lock_release(&bucket->lock);
+
+	block_read(fs_device, index, slot->data);
+
+	lock_acquire(&bucket->lock);
+	slot->state = SECTOR_VALID;
+	cond_broadcast(&bucket->state_changed, &bucket->lock);
+}
+
+/* Returns the cache slot for sector INDEX, reading it from the disk if needed.
+   Only the bucket of INDEX is locked during the lookup and no lock at all is held
+   during the disk read, so the misses only wait for their own sectors. */
 struct sector * take_sector(block_sector_t index, bool block)
 {
 	ASSERT(!intr_context());
-	lock_acquire(&cache.cache_lock);
-	static struct sector element;
-	element.index = index;
-	struct hash_elem * elem = hash_find(&cache.index_sectors_map, &element.hash_elem);
-	if (elem != NULL) {
-		struct sector *res = hash_entry(elem, struct sector, hash_elem);
-		
-		lock_acquire(&res->owners_lock);
-		if(res->owners == 0)
+	struct cache_bucket *bucket = sector_bucket(index);
+	bool have_token = false;
+	while (true) {
+		lock_acquire(&bucket->lock);
+		struct sector *res = bucket_find(bucket, index);
+		if (res != NULL) {
+			if (res->state == SECTOR_EVICTING) {
+				/* Slot goes away after the write; look again afterwards. */
+				while (res->state == SECTOR_EVICTING && res->index == index)
+					cond_wait(&bucket->state_changed, &bucket->lock);
+				lock_release(&bucket->lock);
+				continue;
+			}
+			if (res->owners == 0) {
+				/* First owner of the slot pays a token for it. */
+				if (!have_token && !sema_try_down(&cache.cache_sem)) {
+					lock_release(&bucket->lock);
+					sema_down(&cache.cache_sem);
+					have_token = true;
+					continue;
+				}
+				have_token = false;
+			}
+			res->owners++;
+			if (res->usage < CACHE_MAX_USAGE)
+				res->usage++;
+			/* Waiting for a read in flight (e.g. a prefetch) is a blocking miss as well. */
+			if (res->state == SECTOR_LOADING) bucket->misses++;
+			else bucket->hits++;
+			while (res->state == SECTOR_LOADING)
+				cond_wait(&bucket->state_changed, &bucket->lock);
+			lock_release(&bucket->lock);
+			if (have_token)
+				sema_up(&cache.cache_sem);
+			if (block)
+				lock_acquire(&res->sector_lock);
+			return res;
+		}
+		lock_release(&bucket->lock);
+
+		if (!have_token) {
 			sema_down(&cache.cache_sem);
-		res->owners++;
-		lock_release(&res->owners_lock);
+			have_token = true;
+		}
+		res = claim_slot();
 
-		lock_release(&cache.cache_lock);
-		if (block) 
+		lock_acquire(&bucket->lock);
+		/* Loading it now could read the data from before the write. */
+		while (bypass_pending(bucket, index))
+			cond_wait(&bucket->state_changed, &bucket->lock);
+		if (bucket_find(bucket, index) != NULL) {
+			/* Somebody else has loaded it in the mean time. */
+			lock_release(&bucket->lock);
+			unclaim_slot(res);
+			continue;
+		}
+		bucket->misses++;
+		load_sector(bucket, res, index);
+		lock_release(&bucket->lock);
+		if (block)
 			lock_acquire(&res->sector_lock);
 		return res;
 	}
+}
 
-	sema_down(&cache.cache_sem);
+/* Reads sector INDEX into the cache, unless it is there already.
+   Never waits for a slot; if all of them are in use, the sector is just not prefetched. */
+void cache_prefetch(block_sector_t index)
+{
+	ASSERT(!intr_context());
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
+	bool cached = (bucket_find(bucket, index) != NULL);
+	lock_release(&bucket->lock);
+	if (cached || !sema_try_down(&cache.cache_sem)) return;
 
-	if (list_empty(&cache.free_list)) evict_sector();
-	struct sector *res = list_entry(list_pop_back(&cache.free_list), struct sector, list_elem);
-	res->index = index;
-	res->dirty = false;
-	res->owners = 1;
-	block_read(fs_device, index, res->data);
-	hash_insert(&cache.index_sectors_map, &res->hash_elem);
-	
-	lock_release(&cache.cache_lock);
-	if (block) 
-		lock_acquire(&res->sector_lock);
-	return res;
+	struct sector *slot = claim_slot();
+	lock_acquire(&bucket->lock);
+	if (bucket_find(bucket, index) != NULL || bypass_pending(bucket, index)) {
+		lock_release(&bucket->lock);
+		unclaim_slot(slot);
+		sema_up(&cache.cache_sem);
+		return;
+	}
+	bucket->prefetches++;
+	load_sector(bucket, slot, index);
+	/* Survive one sweep of the clock hand, so that the reader gets to it in time.
+	   Readers, that joined during the load, take over the token of the slot. */
+	slot->usage = 1;
+	slot->owners--;
+	bool unused = (slot->owners == 0);
+	lock_release(&bucket->lock);
+	if (unused)
+		sema_up(&cache.cache_sem);
 }
 
 void release_sector(struct sector *sec, block_sector_t index, bool changed, bool blocked)
 {
 	ASSERT(!intr_context());
 	ASSERT(sec->index == index);
-	lock_acquire(&sec->owners_lock);
+	if (blocked)
+		lock_release(&sec->sector_lock);
+
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
 	if (changed)
-		sec->dirty = true;
+		mark_dirty(sec);
 	sec->owners--;
-	if (sec->owners == 0)
+	bool unused = (sec->owners == 0);
+	lock_release(&bucket->lock);
+	if (unused)
 		sema_up(&cache.cache_sem);
-	lock_release(&sec->owners_lock);
+}
 
-	if(blocked)
-		lock_release(&sec->sector_lock);
+
+
+/* Reads sector INDEX into BUFFER. The cached copy is used, if there is one;
+   otherwise the sector is read straight from the disk, without taking a slot,
+   so that a large streaming read does not push everything else out of the cache. */
+void cache_read_through(block_sector_t index, void *buffer) {
+	ASSERT(!intr_context());
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
+	bool cached = (bucket_find(bucket, index) != NULL);
+	if (!cached) bucket->bypasses++;
+	lock_release(&bucket->lock);
+	if (!cached) {
+		block_read(fs_device, index, buffer);
+		return;
+	}
+	struct sector *sec = take_sector(index, true);
+	memcpy(buffer, sec->data, BLOCK_SECTOR_SIZE);
+	release_sector(sec, index, false, true);
+}
+
+/* Writes BUFFER as sector INDEX. The cached copy is updated, if there is one;
+   otherwise the sector is written straight to the disk. Until that write is
+   done, the sector is not loaded into the cache, so the cache never holds
+   the data from before it. */
+void cache_write_through(block_sector_t index, const void *buffer) {
+	ASSERT(!intr_context());
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
+	if (bucket_find(bucket, index) == NULL) {
+		struct bypass_write write;
+		write.index = index;
+		list_push_back(&bucket->bypass, &write.elem);
+		bucket->bypasses++;
+		lock_release(&bucket->lock);
+		block_write(fs_device, index, buffer);
+		lock_acquire(&bucket->lock);
+		list_remove(&write.elem);
+		cond_broadcast(&bucket->state_changed, &bucket->lock);
+		lock_release(&bucket->lock);
+		return;
+	}
+	lock_release(&bucket->lock);
+	struct sector *sec = take_sector(index, true);
+	memcpy(sec->data, buffer, BLOCK_SECTOR_SIZE);
+	release_sector(sec, index, true, true);
+}
+
+/* Marks SEC dirty. Bucket lock of SEC has to be held. */
+static void mark_dirty(struct sector *sec) {
+	if (sec->dirty) return;
+	sec->dirty = true;
+	lock_acquire(&cache.dirty_lock);
+	list_push_back(&cache.dirty_list, &sec->dirty_elem);
+	cache.dirty_cnt++;
+	lock_release(&cache.dirty_lock);
+}
+
+/* Marks SEC clean. Bucket lock of SEC has to be held. */
+static void mark_clean(struct sector *sec) {
+	if (!sec->dirty) return;
+	sec->dirty = false;
+	lock_acquire(&cache.dirty_lock);
+	list_remove(&sec->dirty_elem);
+	cache.dirty_cnt--;
+	lock_release(&cache.dirty_lock);
+}
+
+/* Pins SEC, which the caller owns, for the journal: until it is unpinned,
+   it is neither written back nor evicted, so that the disk never sees
+   a change, that is not committed to the journal yet. */
+void cache_pin_sector(struct sector *sec) {
+	struct cache_bucket *bucket = sector_bucket(sec->index);
+	lock_acquire(&bucket->lock);
+	sec->pinned = true;
+	lock_release(&bucket->lock);
+}
+
+/* Copies the data of pinned sector INDEX into BUFFER. */
+void cache_copy_pinned(block_sector_t index, void *buffer) {
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
+	struct sector *sec = bucket_find(bucket, index);
+	ASSERT(sec != NULL && sec->pinned);
+	memcpy(buffer, sec->data, BLOCK_SECTOR_SIZE);
+	lock_release(&bucket->lock);
 }
 
+/* Unpins sector INDEX; it is written back and evicted as usual from now on. */
+void cache_unpin_sector(block_sector_t index) {
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
+	struct sector *sec = bucket_find(bucket, index);
+	ASSERT(sec != NULL && sec->pinned);
+	sec->pinned = false;
+	lock_release(&bucket->lock);
+}
 
+/* Writes sector INDEX back to the disk, if it is cached, dirty and not pinned.
+   The write is made from a copy in BUFFER, so that the readers and writers
+   of the sector are never blocked by it. A write of the sector, that is in
+   flight already, is waited for, so that the data is on the disk on return. */
+static void flush_sector(block_sector_t index, char *buffer) {
+	struct cache_bucket *bucket = sector_bucket(index);
+	lock_acquire(&bucket->lock);
+	struct sector *cur;
+	while ((cur = bucket_find(bucket, index)) != NULL && (cur->writing || cur->state == SECTOR_EVICTING))
+		cond_wait(&bucket->state_changed, &bucket->lock);
+	if (cur != NULL && cur->state == SECTOR_VALID && cur->dirty && !cur->pinned) {
+		cur->writing = true;
+		mark_clean(cur);
+		memcpy(buffer, cur->data, BLOCK_SECTOR_SIZE);
+		lock_release(&bucket->lock);
+		block_write(fs_device, index, buffer);
+		lock_acquire(&bucket->lock);
+		cur->writing = false;
+		cond_broadcast(&bucket->state_changed, &bucket->lock);
+	}
+	lock_release(&bucket->lock);
+}
+
+static int sector_index_compare(const void *a, const void *b, void *aux UNUSED) {
+	block_sector_t sector_a = *((const block_sector_t*)a);
+	block_sector_t sector_b = *((const block_sector_t*)b);
+	return (sector_a < sector_b) ? (-1) : (sector_a > sector_b);
+}
 
-int64_t last_flush_t = 0;
-void sector_cache_flush(bool force) {
+/* Writes back the dirty ones among CNT given SECTORS, in ascending order
+   (so that the disk head moves in one direction). Sorts SECTORS. */
+void cache_flush_sectors(block_sector_t *sectors, size_t cnt) {
 	ASSERT(!intr_context());
-	int64_t t = timer_ticks();
-	if (force || (t - last_flush_t) > 512) {
-		lock_acquire(&cache.cache_lock);
-		uint32_t i;
-		for (i = 0; i < SECTOR_COUNT; i++) {
-			struct sector * cur = (cache.sectors + i);
-			if (cur->index != (block_sector_t)(-1))
-				if (cur->dirty) {
-					lock_acquire(&cur->owners_lock);
-					block_write(fs_device, cur->index, cur->data);
-					cur->dirty = false;
-					lock_release(&cur->owners_lock);
-				}
-		}
-		lock_release(&cache.cache_lock);
-		last_flush_t = t;
+	if (cnt == 0) return;
+	char *buffer = malloc(BLOCK_SECTOR_SIZE);
+	if (buffer == NULL) return;
+	sort(sectors, cnt, sizeof(block_sector_t), sector_index_compare, NULL);
+	size_t i;
+	for (i = 0; i < cnt; i++)
+		flush_sector(sectors[i], buffer);
+	free(buffer);
+}
+
+/* Writes every dirty sector back to the disk; only the sectors on the dirty list are touched.
+   Pinned sectors stay dirty, until the journal commits them. */
+void sector_cache_flush(void) {
+	ASSERT(!intr_context());
+	if (cache.sector_cnt == 0) return;	/* Cache was never initialized. */
+	lock_acquire(&cache.dirty_lock);
+	size_t cnt = cache.dirty_cnt;
+	lock_release(&cache.dirty_lock);
+	if (cnt == 0) return;
+
+	block_sector_t *sectors = malloc(sizeof(block_sector_t) * cnt);
+	if (sectors == NULL) return;
+	size_t i = 0;
+	lock_acquire(&cache.dirty_lock);
+	struct list_elem *e;
+	for (e = list_begin(&cache.dirty_list); e != list_end(&cache.dirty_list) && i < cnt; e = list_next(e))
+		sectors[i++] = list_entry(e, struct sector, dirty_elem)->index;
+	lock_release(&cache.dirty_lock);
+	cache_flush_sectors(sectors, i);
+	free(sectors);
+}
+
+/* Prints buffer cache statistics. */
+void cache_print_stats(void) {
+	unsigned long long hits = 0, misses = 0, evictions = 0, prefetches = 0, bypasses = 0;
+	unsigned int i;
+	for (i = 0; i < CACHE_BUCKET_COUNT; i++) {
+		hits += cache.buckets[i].hits;
+		misses += cache.buckets[i].misses;
+		evictions += cache.buckets[i].evictions;
+		prefetches += cache.buckets[i].prefetches;
+		bypasses += cache.buckets[i].bypasses;
 	}
+	printf("Cache: %llu hits, %llu misses, %llu evictions, %llu prefetches, %llu bypasses (%zu sectors)\n",
+		hits, misses, evictions, prefetches, bypasses, cache.sector_cnt);
 }
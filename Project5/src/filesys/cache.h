@@ -1,39 +1,91 @@
-
 #ifndef CACHE_H
 #define CACHE_H
 #include "lib/stdbool.h"
 #include "devices/block.h"
 #include "threads/synch.h"
-#include "lib/kernel/hash.h"
+#include "lib/kernel/list.h"
 
-#define SECTOR_COUNT 64
+#define CACHE_DEFAULT_SECTOR_COUNT 64	/* Default for -cache=N. */
+#define CACHE_MIN_SECTOR_COUNT 16
 #define WRITE_BEHIND_SLEEP_TICKS 256
 
+/* Maximal value of the usage counter of a slot; a slot with the count of N
+   survives N sweeps of the clock hand without being referenced. */
+#define CACHE_MAX_USAGE 3
+
+/* Number of independently locked hash buckets (lock stripes)
+   the cached sectors are spread over. */
+#define CACHE_BUCKET_COUNT 16
+
+/* State of a cache slot. */
+enum sector_state {
+	SECTOR_FREE,		/* Slot holds no sector. */
+	SECTOR_LOADING,		/* Sector is being read from disk, data is not valid yet. */
+	SECTOR_VALID,		/* Data is valid. */
+	SECTOR_EVICTING		/* Sector is being written back before the slot is reused. */
+};
+
 struct sector {
 	block_sector_t index;
-	char data[BLOCK_SECTOR_SIZE];
-	bool dirty;
-	uint32_t owners;
+	char *data;					/* BLOCK_SECTOR_SIZE bytes inside a palloc'd page. */
+	enum sector_state state;	/* Protected by the bucket lock. */
+	bool dirty;					/* Protected by the bucket lock; true, iff on the dirty list. */
+	bool writing;				/* True, while the flusher writes a copy of the data. */
+	bool pinned;				/* Protected by the bucket lock; held back for the journal,
+								   neither written back nor evicted. */
+	uint32_t owners;			/* Protected by the bucket lock. */
+	uint8_t usage;				/* Protected by the bucket lock; see CACHE_MAX_USAGE. */
 	struct lock sector_lock;
-	struct lock owners_lock;
-	struct hash_elem hash_elem;
+	struct list_elem bucket_elem;
 	struct list_elem list_elem;
+	struct list_elem dirty_elem;
 };
+
+/* Sectors with the same (index % CACHE_BUCKET_COUNT) share a bucket and its lock. */
+struct cache_bucket {
+	struct lock lock;
+	struct condition state_changed;	/* Signalled, when a slot stops LOADING or EVICTING
+									   and when a bypass write is done. */
+	struct list sectors;
+	struct list bypass;				/* Writes of uncached sectors in flight. */
+	unsigned long long hits;		/* Statistics for the sectors of the bucket. */
+	unsigned long long misses;
+	unsigned long long evictions;
+	unsigned long long prefetches;
+	unsigned long long bypasses;	/* Transfers of uncached sectors, that skipped the cache. */
+};
+
 struct cache {
-	struct sector sectors[SECTOR_COUNT];
-	struct lock cache_lock;
-	struct semaphore cache_sem;
-	struct hash index_sectors_map;
+	struct sector *sectors;
+	size_t sector_cnt;
+	struct cache_bucket buckets[CACHE_BUCKET_COUNT];
+	struct lock evict_lock;		/* Protects the clock hand and the free list. */
+	struct semaphore cache_sem;	/* Number of slots, that can still be claimed. */
 	struct list free_list;
+	struct lock dirty_lock;		/* Protects the dirty list; taken inside bucket locks. */
+	struct list dirty_list;		/* Dirty sectors, the only ones write-behind touches. */
+	size_t dirty_cnt;
 };
 
 void sector_init(struct sector *sec);
-void cache_init(void);
+void cache_init(size_t sector_cnt);
+size_t cache_sector_count(void);
+void cache_print_stats(void);
 
 struct sector * take_sector(block_sector_t index, bool block);
 
 void release_sector(struct sector *sec, block_sector_t index, bool changed, bool blocked);
 
-void sector_cache_flush(bool force);
+void cache_prefetch(block_sector_t index);
+
+void cache_read_through(block_sector_t index, void *buffer);
+void cache_write_through(block_sector_t index, const void *buffer);
+
+void cache_pin_sector(struct sector *sec);
+void cache_copy_pinned(block_sector_t index, void *buffer);
+void cache_unpin_sector(block_sector_t index);
+
+void cache_flush_sectors(block_sector_t *sectors, size_t cnt);
+void sector_cache_flush(void);
 
 #endif
@@ -0,0 +1,173 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Dentry cache: remembers, which inode sector the name NAME in the
+   directory with inode sector PARENT refers to, or that there is no
+   such name (a negative entry), so that the path resolution does not
+   have to search the same directories over and over again.
+
+   The entries are kept up to date by the directory code, under the
+   same directory lock as its lookups: it calls dcache_insert() when
+   it adds a name, and again with DCACHE_NEGATIVE when it removes one,
+   and dcache_purge_dir() when it removes a directory.  Once full, the
+   least recently used entry is reused. */
+
+/* A cached path component. */
+struct dentry
+  {
+    block_sector_t parent;              /* Inode sector of the directory. */
+    char name[NAME_MAX + 1];            /* Name in the directory. */
+    block_sector_t sector;              /* Inode sector or DCACHE_NEGATIVE. */
+    bool in_use;                        /* True if in the table. */
+    struct hash_elem hash_elem;         /* Element in the table. */
+    struct list_elem lru_elem;          /* Element in the LRU list. */
+  };
+
+static struct dentry dentries[DCACHE_SIZE];
+static struct hash table;               /* Entries in use, by parent and name. */
+static struct list lru;                 /* All entries, least recently used first. */
+static struct lock dcache_lock;         /* Protects all of the above. */
+
+static unsigned long long hit_cnt;      /* Statistics. */
+static unsigned long long miss_cnt;
+
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+  if (a->parent != b->parent)
+    return a->parent < b->parent;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the entry for NAME in PARENT or a null pointer.
+   Dcache lock has to be held. */
+static struct dentry *
+find (block_sector_t parent, const char *name)
+{
+  static struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&table, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Drops entry D from the table and makes it the first to be reused.
+   Dcache lock has to be held. */
+static void
+drop (struct dentry *d)
+{
+  hash_delete (&table, &d->hash_elem);
+  d->in_use = false;
+  list_remove (&d->lru_elem);
+  list_push_front (&lru, &d->lru_elem);
+}
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  if (!hash_init (&table, dentry_hash, dentry_less, NULL))
+    PANIC ("can't initialize the dentry cache");
+  list_init (&lru);
+  lock_init (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      dentries[i].in_use = false;
+      list_push_back (&lru, &dentries[i].lru_elem);
+    }
+}
+
+/* Looks NAME in directory PARENT up.  If it is cached, returns true
+   and sets *SECTOR to its inode sector, or to DCACHE_NEGATIVE, if
+   the name is known not to exist.  Otherwise returns false. */
+bool
+dcache_lookup (block_sector_t parent, const char *name,
+               block_sector_t *sector)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (parent, name);
+  if (d != NULL)
+    {
+      *sector = d->sector;
+      list_remove (&d->lru_elem);
+      list_push_back (&lru, &d->lru_elem);
+      hit_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Remembers, that NAME in directory PARENT refers to the inode in
+   SECTOR, or, if SECTOR is DCACHE_NEGATIVE, that it does not exist. */
+void
+dcache_insert (block_sector_t parent, const char *name,
+               block_sector_t sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+  lock_acquire (&dcache_lock);
+  d = find (parent, name);
+  if (d == NULL)
+    {
+      d = list_entry (list_front (&lru), struct dentry, lru_elem);
+      if (d->in_use)
+        hash_delete (&table, &d->hash_elem);
+      d->parent = parent;
+      strlcpy (d->name, name, sizeof d->name);
+      d->in_use = true;
+      hash_insert (&table, &d->hash_elem);
+    }
+  d->sector = sector;
+  list_remove (&d->lru_elem);
+  list_push_back (&lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets all the names in directory PARENT, which is being removed
+   (its sector may later hold a different directory). */
+void
+dcache_purge_dir (block_sector_t parent)
+{
+  size_t i;
+
+  lock_acquire (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    if (dentries[i].in_use && dentries[i].parent == parent)
+      drop (dentries + i);
+  lock_release (&dcache_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dcache_print_stats (void)
+{
+  printf ("Dcache: %llu hits, %llu misses\n", hit_cnt, miss_cnt);
+}
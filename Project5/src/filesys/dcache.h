@@ -0,0 +1,21 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Number of path components the dentry cache remembers. */
+#define DCACHE_SIZE 128
+
+/* Sector of a negative entry: the name is known not to exist. */
+#define DCACHE_NEGATIVE ((block_sector_t) -1)
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t parent, const char *name,
+                    block_sector_t *sector);
+void dcache_insert (block_sector_t parent, const char *name,
+                    block_sector_t sector);
+void dcache_purge_dir (block_sector_t parent);
+void dcache_print_stats (void);
+
+#endif /* filesys/dcache.h */
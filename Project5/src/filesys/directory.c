@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
+#include <hash.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -12,7 +14,6 @@ struct dir
   {
     struct inode *inode;                /* Backing store. */
     off_t pos;                          /* Current position. */
-    struct lock dir_lock;               /* To serialize access to some segments. */
   };
 
 /* A single directory entry. */
@@ -23,6 +24,85 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Small directories are a plain array of entries.  Large ones are
+   "hashed": an array of buckets, one sector each, where the entry
+   for NAME lives in bucket hash_string (NAME) % (number of buckets),
+   which is a power of two.  Lookups then read a single sector.  When
+   a bucket overflows, the number of buckets is doubled and all the
+   entries are rehashed. */
+
+/* Directory entries per sector (and per bucket). */
+#define DIR_ENTRIES_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* A plain directory is hashed, when it has no free entry left and is
+   at least this many sectors long. */
+#define DIR_HASH_MIN_SECTORS 2
+
+/* Maximal number of buckets of a hashed directory. */
+#define DIR_MAX_BUCKETS 256
+
+/* Goes over the entries of a directory, a sector at a time: the
+   sector of the current entry stays pinned in the buffer cache,
+   until the iterator moves past it. */
+struct dir_iter
+  {
+    struct inode *inode;                /* Directory inode. */
+    off_t ofs;                          /* Offset of the next entry. */
+    off_t end;                          /* Offset to stop at. */
+    bool pinned;                        /* True if REF is pinned. */
+    struct inode_sector_ref ref;        /* Sector of the current entry. */
+  };
+
+/* Starts iterating over the entries of DIR between byte offsets
+   START and END. */
+static void
+iter_init (struct dir_iter *it, struct dir *dir, off_t start, off_t end)
+{
+  it->inode = dir->inode;
+  it->ofs = start;
+  it->end = end;
+  it->pinned = false;
+}
+
+/* Returns the next entry of IT and stores its offset in *OFSP, or
+   returns a null pointer if there are no more.  The entry stays
+   valid until the next call or until iter_finish(). */
+static const struct dir_entry *
+iter_next (struct dir_iter *it, off_t *ofsp)
+{
+  const struct dir_entry *e;
+  off_t sector_ofs = it->ofs % BLOCK_SECTOR_SIZE;
+
+  if (it->ofs >= it->end
+      || it->ofs + (off_t) sizeof *e > inode_length (it->inode))
+    return NULL;
+  if (it->pinned && sector_ofs == 0)
+    {
+      inode_unpin_sector (&it->ref);
+      it->pinned = false;
+    }
+  if (!it->pinned)
+    {
+      if (!inode_pin_sector (it->inode, it->ofs, &it->ref))
+        return NULL;
+      it->pinned = true;
+    }
+  e = (const struct dir_entry *) (it->ref.data + sector_ofs);
+  if (ofsp != NULL)
+    *ofsp = it->ofs;
+  it->ofs += sizeof *e;
+  return e;
+}
+
+/* Finishes iterating with IT. */
+static void
+iter_finish (struct dir_iter *it)
+{
+  if (it->pinned)
+    inode_unpin_sector (&it->ref);
+  it->pinned = false;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -53,7 +133,6 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
-      lock_init(&dir->dir_lock);
       return dir;
     }
   else
@@ -98,37 +177,107 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns the byte offset of the bucket of hashed DIR, that holds
+   the entry for NAME. */
+static off_t
+bucket_ofs (struct dir *dir, const char *name)
+{
+  size_t bucket_cnt = inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+  return (hash_string (name) & (bucket_cnt - 1)) * BLOCK_SECTOR_SIZE;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   DIR has to be locked. */
 static bool
 lookup (struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
-  struct dir_entry e;
-  size_t ofs;
+  struct dir_iter it;
+  const struct dir_entry *e;
+  off_t ofs, end;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  lock_acquire(&dir->dir_lock);
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
+  ofs = 0;
+  end = inode_length (dir->inode);
+  if (inode_is_hashed_dir (dir->inode))
+    {
+      ofs = bucket_ofs (dir, name);
+      end = ofs + BLOCK_SECTOR_SIZE;
+    }
+  iter_init (&it, dir, ofs, end);
+  while ((e = iter_next (&it, &ofs)) != NULL)
+    if (e->in_use && !strcmp (name, e->name)) 
       {
         if (ep != NULL)
-          *ep = e;
+          *ep = *e;
         if (ofsp != NULL)
           *ofsp = ofs;
-        lock_release(&dir->dir_lock);
+        iter_finish (&it);
         return true;
       }
-  lock_release(&dir->dir_lock);
+  iter_finish (&it);
   return false;
 }
 
+/* Rewrites DIR in the hashed format with BUCKET_CNT buckets, or
+   with more, if some bucket would overflow otherwise.  Returns true
+   if successful, false on failure.  DIR has to be locked. */
+static bool
+rehash (struct dir *dir, size_t bucket_cnt)
+{
+  off_t length = inode_length (dir->inode);
+  size_t entry_cnt = length / sizeof (struct dir_entry);
+  struct dir_entry *entries = malloc (length);
+  bool success = false;
+
+  if (entries == NULL
+      || inode_read_at (dir->inode, entries, length, 0) != length)
+    goto done;
+
+  /* The directory can not shrink. */
+  while (bucket_cnt * BLOCK_SECTOR_SIZE < (size_t) length)
+    bucket_cnt *= 2;
+  for (; bucket_cnt <= DIR_MAX_BUCKETS && !success; bucket_cnt *= 2)
+    {
+      struct dir_entry *buckets = calloc (bucket_cnt, BLOCK_SECTOR_SIZE);
+      off_t size = bucket_cnt * BLOCK_SECTOR_SIZE;
+      size_t i, j;
+
+      if (buckets == NULL)
+        goto done;
+      for (i = 0; i < entry_cnt; i++) 
+        if (entries[i].in_use)
+          {
+            struct dir_entry *bucket = buckets + DIR_ENTRIES_PER_SECTOR
+              * (hash_string (entries[i].name) & (bucket_cnt - 1));
+            for (j = 0; j < DIR_ENTRIES_PER_SECTOR && bucket[j].in_use; j++)
+              continue;
+            if (j == DIR_ENTRIES_PER_SECTOR)
+              break;
+            bucket[j] = entries[i];
+          }
+      if (i == entry_cnt) 
+        {
+          /* Everything fits. */
+          if (inode_rehash_dir (dir->inode, buckets, size))
+            success = true;
+          else
+            bucket_cnt = DIR_MAX_BUCKETS;
+        }
+      free (buckets);
+    }
+
+ done:
+  free (entries);
+  return success;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -137,15 +286,21 @@ bool
 dir_lookup (struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t parent, sector;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  parent = inode_get_inumber (dir->inode);
+  inode_lock_dir (dir->inode);
+  if (!dcache_lookup (parent, name, &sector))
+    {
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_NEGATIVE;
+      dcache_insert (parent, name, sector);
+    }
+  *inode = sector != DCACHE_NEGATIVE ? inode_open (sector) : NULL;
+  inode_unlock_dir (dir->inode);
 
   return *inode != NULL;
 }
@@ -159,8 +314,10 @@ dir_lookup (struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_iter it;
+  const struct dir_entry *free_e;
   struct dir_entry e;
-  off_t ofs;
+  off_t ofs, end;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -170,31 +327,57 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  inode_lock_dir (dir->inode);
+
   /* Check that NAME is not in use. */
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
   /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  lock_acquire(&dir->dir_lock);
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+     If there are no free slots in a plain directory, then it will
+     be set to the current end-of-file; full buckets of a hashed
+     directory are split by rehashing. */
+  while (true) 
+    {
+      ofs = 0;
+      end = inode_length (dir->inode);
+      if (inode_is_hashed_dir (dir->inode))
+        {
+          ofs = bucket_ofs (dir, name);
+          end = ofs + BLOCK_SECTOR_SIZE;
+        }
+      iter_init (&it, dir, ofs, end);
+      while ((free_e = iter_next (&it, &ofs)) != NULL && free_e->in_use)
+        continue;
+      iter_finish (&it);
+      if (free_e != NULL)
+        break;
+      ofs = end;
+
+      if (inode_is_hashed_dir (dir->inode))
+        {
+          if (!rehash (dir, 2 * (end / BLOCK_SECTOR_SIZE)))
+            goto done;
+        }
+      else if (end >= DIR_HASH_MIN_SECTORS * BLOCK_SECTOR_SIZE)
+        {
+          if (!rehash (dir, 1))
+            goto done;
+        }
+      else
+        break;
+    }
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-  lock_release(&dir->dir_lock);
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
 
  done:
+  inode_unlock_dir (dir->inode);
   return success;
 }
 
@@ -212,6 +395,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock_dir (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -223,16 +408,20 @@ dir_remove (struct dir *dir, const char *name)
 
   /* Erase directory entry. */
   e.in_use = false;
-  lock_acquire(&dir->dir_lock);
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
+  /* Forget the name and, for a directory, the names in it. */
+  dcache_insert (inode_get_inumber (dir->inode), name, DCACHE_NEGATIVE);
+  if (inode_is_dir (inode))
+    dcache_purge_dir (e.inode_sector);
+
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
-  lock_release(&dir->dir_lock);
+  inode_unlock_dir (dir->inode);
   inode_close (inode);
   return success;
 }
@@ -243,25 +432,28 @@ dir_remove (struct dir *dir, const char *name)
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
-  struct dir_entry e;
+  struct dir_iter it;
+  const struct dir_entry *e;
+  bool found = false;
 
-  lock_acquire(&dir->dir_lock);
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock_dir (dir->inode);
+  iter_init (&it, dir, dir->pos, inode_length (dir->inode));
+  while (!found && (e = iter_next (&it, NULL)) != NULL) 
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      dir->pos += sizeof *e;
+      if (e->in_use)
         {
           /* Skip implied "." and ".." */
-          if (strcmp(e.name, ".") == 0 || strcmp(e.name, "..") == 0)
+          if (strcmp(e->name, ".") == 0 || strcmp(e->name, "..") == 0)
             continue;
 
-          strlcpy (name, e.name, NAME_MAX + 1);
-          lock_release(&dir->dir_lock);
-          return true;
+          strlcpy (name, e->name, NAME_MAX + 1);
+          found = true;
         } 
     }
-  lock_release(&dir->dir_lock);
-  return false;
+  iter_finish (&it);
+  inode_unlock_dir (dir->inode);
+  return found;
 }
 
 int
@@ -269,16 +461,19 @@ dir_num_entries (struct dir *dir)
 {
   ASSERT (dir != NULL);
 
-  struct dir_entry e;
+  struct dir_iter it;
+  const struct dir_entry *e;
   int num_entries = 0;
-  lock_acquire(&dir->dir_lock);
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock_dir (dir->inode);
+  iter_init (&it, dir, dir->pos, inode_length (dir->inode));
+  while ((e = iter_next (&it, NULL)) != NULL) 
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      dir->pos += sizeof *e;
+      if (e->in_use)
         num_entries += 1;
     }
-  lock_release(&dir->dir_lock);
+  iter_finish (&it);
+  inode_unlock_dir (dir->inode);
   /* Don't count '.' and '..' */
   return num_entries - 2;
 }
@@ -9,7 +9,7 @@ struct file
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
-    struct lock lock;           /* Lock for file access. */
+    struct lock lock;           /* Serializes the reads and writes at POS. */
     bool deny_write;            /* Has file_deny_write() been called? */
 #ifdef FILESYS
 	bool is_dir;				/* True, if the file is a directory. */
@@ -28,8 +28,8 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      lock_init (&file->lock);
 #ifdef FILESYS
-      lock_init(&file->lock);
 	  file->is_dir = inode_is_dir(inode);
 #endif
       return file;
@@ -77,8 +77,12 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  lock_acquire (&file->lock);
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
+  lock_release (&file->lock);
   return bytes_read;
 }
 
@@ -103,8 +107,12 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  lock_acquire (&file->lock);
+  bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
+  lock_release (&file->lock);
   return bytes_written;
 }
 
@@ -122,6 +130,41 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Reads from FILE into the IOV_CNT buffers in IOV, one after
+   another, starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than their total length if end of file is
+   reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, size_t iov_cnt)
+{
+  off_t bytes_read;
+
+  lock_acquire (&file->lock);
+  bytes_read = inode_readv_at (file->inode, iov, iov_cnt, file->pos);
+  file->pos += bytes_read;
+  lock_release (&file->lock);
+  return bytes_read;
+}
+
+/* Writes the IOV_CNT buffers in IOV, one after another, into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than their total length if an error occurs.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, size_t iov_cnt)
+{
+  off_t bytes_written;
+
+  lock_acquire (&file->lock);
+  bytes_written = inode_writev_at (file->inode, iov, iov_cnt, file->pos);
+  file->pos += bytes_written;
+  lock_release (&file->lock);
+  return bytes_written;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
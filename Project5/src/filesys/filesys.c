@@ -7,6 +7,8 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/dcache.h"
+#include "filesys/journal.h"
 #ifdef FILESYS
 #include "cache.h"
 #endif
@@ -14,11 +16,17 @@
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* If true, filesys_done() leaves the disk as it is, as if the
+   machine crashed. */
+static bool simulate_crash;
+
 static void do_format (void);
-static bool approach_leaf(const char *, struct dir **, char *);
+static bool approach_leaf(struct dir *, const char *, struct dir **, char *);
 
-/* Parses 'path' and populates last filename and cotaining dir. */
-static bool approach_leaf(const char *path, 
+/* Parses 'path' and populates last filename and cotaining dir.
+   Relative paths start from 'base', or from the working directory
+   if 'base' is NULL. */
+static bool approach_leaf(struct dir *base, const char *path,
                           struct dir **containing_dir, 
                           char *filename){
   int path_len = strnlen(path, MAX_PATH_LEN + 1);
@@ -36,7 +44,7 @@ static bool approach_leaf(const char *path,
   if (path[0] == PATH_DELIM_CHAR) 
     cur_dir = dir_open_root();
   else 
-    cur_dir = dir_reopen(thread_current()->pwd);
+    cur_dir = dir_reopen(base != NULL ? base : thread_current()->pwd);
   /* This may occur if inode encapsulated by cur_dir is set 'removed'. */
   if (cur_dir == NULL)
     return false;
@@ -82,8 +90,14 @@ filesys_init (bool format)
     PANIC ("No file system device found, can't initialize file system.");
 
   inode_init ();
+  dcache_init ();
   free_map_init ();
 
+  if (!format
+      && (!inode_format_ok (FREE_MAP_SECTOR) || !inode_format_ok (ROOT_DIR_SECTOR)))
+    PANIC ("File system has an old or unknown format, reformat it with -f.");
+  journal_init (format);
+
   if (format) 
     do_format ();
 
@@ -95,23 +109,53 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
-  sector_cache_flush(true);
+  if (simulate_crash)
+    return;
+  journal_done ();
+  sector_cache_flush();
   free_map_close ();
 }
 
+/* Writes all unwritten data to disk, but keeps the file system
+   running.  Must not be called with a journal handle open. */
+void
+filesys_sync (void)
+{
+  journal_sync ();
+  sector_cache_flush ();
+}
+
+/* Makes filesys_done() write nothing back, so that the next start
+   finds the disk as it would after a crash.  For testing recovery. */
+void
+filesys_simulate_crash (void)
+{
+  simulate_crash = true;
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
    or if internal memory allocation fails. */
 bool
 filesys_create (const char *path, off_t initial_size, bool is_dir) 
+{
+  return filesys_create_at (NULL, path, initial_size, is_dir);
+}
+
+/* Like filesys_create(), but a relative PATH starts from directory
+   BASE instead of the working directory. */
+bool
+filesys_create_at (struct dir *base, const char *path, off_t initial_size,
+                   bool is_dir)
 {
   char filename[NAME_MAX + 1];
   struct dir *containing_dir;
-  if (!approach_leaf(path, &containing_dir, filename))
+  if (!approach_leaf(base, path, &containing_dir, filename))
     return false;
 
   ASSERT (containing_dir != NULL);
+  journal_begin ();
 
   block_sector_t inode_sector = 0;
   uint32_t dir_inode_sector = inode_get_inumber(dir_get_inode(containing_dir));
@@ -131,6 +175,7 @@ filesys_create (const char *path, off_t initial_size, bool is_dir)
     free_map_release (inode_sector, 1);
   }
   dir_close (containing_dir);
+  journal_end ();
   return success;
 }
 
@@ -141,6 +186,14 @@ filesys_create (const char *path, off_t initial_size, bool is_dir)
    or if an internal memory allocation fails. */
 struct file *
 filesys_open (const char *path)
+{
+  return filesys_open_at (NULL, path);
+}
+
+/* Like filesys_open(), but a relative PATH starts from directory
+   BASE instead of the working directory. */
+struct file *
+filesys_open_at (struct dir *base, const char *path)
 {
   /* Special case if path is root dir. */
   if (strcmp(path, PATH_DELIM_STRING) == 0)
@@ -148,7 +201,7 @@ filesys_open (const char *path)
 
   char filename[NAME_MAX + 1];
   struct dir *containing_dir;
-  if (!approach_leaf(path, &containing_dir, filename))
+  if (!approach_leaf(base, path, &containing_dir, filename))
     return NULL;
 
   ASSERT (containing_dir != NULL);
@@ -166,13 +219,21 @@ filesys_open (const char *path)
 bool
 filesys_remove (const char *path) 
 {
-  
+  return filesys_remove_at (NULL, path);
+}
+
+/* Like filesys_remove(), but a relative PATH starts from directory
+   BASE instead of the working directory. */
+bool
+filesys_remove_at (struct dir *base, const char *path)
+{
   char filename[NAME_MAX + 1];
   struct dir *containing_dir;
-  if (!approach_leaf(path, &containing_dir, filename))
+  if (!approach_leaf(base, path, &containing_dir, filename))
     return false;
 
   ASSERT (containing_dir != NULL);
+  journal_begin ();
 
   struct inode *inode = NULL;
   dir_lookup(containing_dir, filename, &inode);
@@ -184,12 +245,14 @@ filesys_remove (const char *path)
     dir_close(child);
     if (forbid){
       dir_close(containing_dir);
+      journal_end ();
       return false;
     }
   }
 
   bool success = dir_remove(containing_dir, filename);
   dir_close (containing_dir);
+  journal_end ();
 
   return success;
 }
@@ -7,14 +7,23 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* Journal superblock, followed by the log. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
 
 void filesys_init (bool format);
 void filesys_done (void);
+void filesys_sync (void);
+void filesys_simulate_crash (void);
 bool filesys_create (const char *name, off_t initial_size, bool is_dir);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
 
+struct dir;
+bool filesys_create_at (struct dir *, const char *name, off_t initial_size,
+                        bool is_dir);
+struct file *filesys_open_at (struct dir *, const char *name);
+bool filesys_remove_at (struct dir *, const char *name);
+
 #endif /* filesys/filesys.h */
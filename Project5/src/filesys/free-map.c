@@ -4,6 +4,7 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
@@ -17,11 +18,24 @@ free_map_init (void)
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  bitmap_enable_summary (free_map);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_LOG_SECTORS + 1, true);
   lock_init(&free_map_lock);
 }
 
+/* Writes the part of the free map holding sectors SECTOR...SECTOR + CNT - 1
+   to the free map file.  The write goes to the buffer cache, which writes
+   it back to the disk later, so only the touched sectors of the file are
+   ever written.  Free map lock has to be held. */
+static bool
+free_map_write (block_sector_t sector, size_t cnt)
+{
+  return (free_map_file == NULL
+          || bitmap_write_range (free_map, free_map_file, sector, cnt));
+}
+
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
@@ -34,8 +48,7 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 
   block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
   if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+      && !free_map_write (sector, cnt))
     {
       bitmap_set_multiple (free_map, sector, cnt, false); 
       sector = BITMAP_ERROR;
@@ -47,13 +60,62 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Allocates up to CNT consecutive sectors, as close after GOAL as
+   possible, and stores the first into *SECTORP.  Free sectors right
+   at GOAL are taken, even if there are fewer than CNT of them, so that
+   a growing file continues its last run.  Otherwise the first run of
+   CNT free sectors after GOAL (or, failing that, anywhere) is taken,
+   halving CNT until one is found.
+   Returns the number of sectors allocated, 0 if there are none left
+   or if the free_map file could not be written. */
+size_t
+free_map_allocate_near (block_sector_t goal, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  size_t size = bitmap_size (free_map);
+  size_t run = 0;
+  block_sector_t sector = goal;
+
+  lock_acquire(&free_map_lock);
+
+  while (run < cnt && goal + run < size && !bitmap_test (free_map, goal + run))
+    run++;
+  for (; run == 0 && cnt > 0; cnt /= 2)
+    {
+      sector = bitmap_scan (free_map, goal < size ? goal : 0, cnt, false);
+      if (sector == BITMAP_ERROR)
+        sector = bitmap_scan (free_map, 0, cnt, false);
+      if (sector != BITMAP_ERROR)
+        run = cnt;
+    }
+  if (run > 0)
+    {
+      bitmap_set_multiple (free_map, sector, run, true);
+      if (free_map_write (sector, run))
+        *sectorp = sector;
+      else
+        {
+          bitmap_set_multiple (free_map, sector, run, false);
+          run = 0;
+        }
+    }
+
+  lock_release(&free_map_lock);
+  return run;
+}
+
+/* Makes CNT sectors starting at SECTOR available for use.  Their
+   images in the journal are revoked first, so that they are not
+   replayed over whatever the sectors are reused for. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire(&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
+  journal_revoke (sector, cnt);
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  free_map_write (sector, cnt);
+  lock_release(&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -142,6 +142,9 @@ fsutil_extract (char **argv UNUSED)
         }
     }
 
+  /* Make the extracted files durable, before their source is gone. */
+  filesys_sync ();
+
   /* Erase the ustar header from the start of the block device,
      so that the extraction operation is idempotent.  We erase
      two blocks because two blocks of zeros are the ustar
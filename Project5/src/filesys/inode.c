@@ -1,18 +1,63 @@
 #include "filesys/inode.h"
 #include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 #include "cache.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
-#define ON_INODE_DIR_SIZE 125
-#define REDIRECTION_LEVEL 3
+/* Version of the on-disk inode format, stored in every inode.
+   Version 1 (no field) indexed the data through 3 levels of sectors;
+   version 2 uses extents; version 3 file systems have a metadata
+   journal after the root directory inode; version 4 files may have
+   holes between their extents. */
+#define INODE_FORMAT_VERSION 4
+
+/* Bits of the flags of an inode. */
+#define INODE_FLAG_DIR 1                /* Inode is a directory. */
+#define INODE_FLAG_HASHED_DIR 2         /* Directory is in the hashed format. */
+
+/* Number of extents, kept in the inode itself. */
+#define INODE_DIRECT_EXTENTS 40
+/* Number of extents in an overflow extent block. */
+#define EXTENT_BLOCK_EXTENTS 42
+
+/* Number of data sectors to be read ahead of a sequential reader. */
+#define READAHEAD_SECTORS 8
+/* Maximal number of pending read-ahead requests; more are dropped. */
+#define READAHEAD_QUEUE_MAX 16
+
+/* Reads and writes of at least this many bytes stream their full,
+   aligned sectors past the buffer cache. */
+#define STREAM_MIN_BYTES (8 * BLOCK_SECTOR_SIZE)
+
+/* Run of LENGTH consecutive disk sectors, starting at START,
+   holding the data sectors FIRST...FIRST + LENGTH - 1 of a file. */
+struct extent
+  {
+    uint32_t first;                     /* First data sector (index inside file). */
+    block_sector_t start;               /* First disk sector. */
+    uint32_t length;                    /* Number of sectors. */
+  };
+
+/* Extents, that do not fit in the inode, are kept in a chain of these.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct extent_block
+  {
+    block_sector_t next;                /* Next extent block or -1. */
+    uint32_t unused;                    /* Not used. */
+    struct extent extents[EXTENT_BLOCK_EXTENTS];
+  };
 
 /* On-disk inode.
    Must be exactly BLOCK_SECTOR_SIZE bytes long. */
@@ -27,7 +72,11 @@ struct inode_disk
     uint32_t unused[125];               /* Not used. */
 #else
 	uint32_t flags;							/* Flags */
-	block_sector_t dir[ON_INODE_DIR_SIZE];	/* Inode sector directory. */
+	uint32_t extent_cnt;					/* Number of extents, in the inode and in extent blocks. */
+	block_sector_t extent_block;			/* First overflow extent block or -1. */
+	struct extent direct[INODE_DIRECT_EXTENTS];	/* First extents of the file. */
+	uint32_t version;						/* INODE_FORMAT_VERSION. */
+	uint32_t unused[2];						/* Not used. */
 #endif
   };
 
@@ -39,19 +88,45 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* In-memory copy of the extents of an inode. */
+struct extent_map
+  {
+    struct extent *extents;             /* Sorted by data sector; the data sectors
+                                           between them are holes. */
+    size_t cnt;                         /* Number of extents. */
+    size_t capacity;                    /* Allocated length of EXTENTS. */
+    size_t sectors;                     /* End of the last extent. */
+    size_t hint;                        /* Extent of the last successful lookup. */
+  };
+
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
+    struct lock lock;                   /* Protects the counters, LENGTH and REMOVED. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
+    bool loading;                       /* True while the opener reads it from disk;
+                                           protected by open_inodes_lock. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
-    uint32_t is_dir;                    /* True if directory. */
+    uint32_t flags;                     /* INODE_FLAG_*; protected by LOCK. */
+    struct lock dir_lock;               /* Serializes the operations on a directory. */
     off_t length;                       /* Length of data encapsulated by inode. */
+    off_t read_end;                     /* End of the last read (to detect sequential access). */
+    size_t readahead_next;              /* First data sector not requested for read-ahead yet. */
+    struct extent_map map;              /* Extents, loaded at open. */
+    struct lock map_lock;               /* Protects MAP. */
+    struct rwlock rw;                   /* Held for reading by data reads and writes,
+                                           for writing while holes are filled. */
+    struct lock grow_lock;              /* Serializes the writes, that extend the file. */
   };
 
 #ifdef FILESYS
+/* Statistics, printed by inode_print_stats(). */
+static unsigned long long lookup_cnt;       /* Calls to byte_to_sector(). */
+static unsigned long long index_read_cnt;   /* Metadata sectors read to map data. */
+static unsigned long long read_byte_cnt;    /* Bytes returned by inode_read_at(). */
 
 static void *get_sector_handle(block_sector_t sector_id, bool block) {
 	if (sector_id == (block_sector_t)(-1)) return NULL;
@@ -74,6 +149,39 @@ static void release_sector_handle(block_sector_t sector_id, void *sector_data, b
 	release_sector((struct sector*)sector_data, sector_id, made_dirty, blocked);
 #endif
 }
+/* Like get_sector_handle(), for a metadata sector (an inode, an extent block or
+   a data sector of a directory or of the free map), that is about to be changed;
+   the sector joins the running journal transaction first. */
+static void *get_meta_handle(block_sector_t sector_id, bool block) {
+	void *handle = get_sector_handle(sector_id, block);
+#ifdef CACHE_H
+	if (handle != NULL) journal_add((struct sector*)handle);
+#endif
+	return handle;
+}
+/* Releases a metadata sector taken with get_meta_handle() as changed. It joins the
+   journal transaction again, in case the one it was added to has been committed. */
+static void release_meta_handle(block_sector_t sector_id, void *sector_data, bool blocked) {
+#ifdef CACHE_H
+	if (sector_data != NULL) journal_add((struct sector*)sector_data);
+#endif
+	release_sector_handle(sector_id, sector_data, true, blocked);
+}
+/* Releases a newly allocated sector, taken with get_sector_handle() and filled
+   with data, that is not journaled. A sector, that was freed in the running
+   journal transaction, is still pinned by it and not written back before the
+   commit; it joins the transaction then, so that its data is committed with it.
+   Returns true if it has. */
+static bool release_fresh_handle(block_sector_t sector_id, void *sector_data) {
+#ifdef CACHE_H
+	if (((struct sector*)sector_data)->pinned) {
+		release_meta_handle(sector_id, sector_data, true);
+		return true;
+	}
+#endif
+	release_sector_handle(sector_id, sector_data, true, true);
+	return false;
+}
 static void *get_sector_data(void *sector_handle) {
 #ifndef CACHE_H
 	return sector_handle;
@@ -82,124 +190,267 @@ static void *get_sector_data(void *sector_handle) {
 #endif
 }
 
-static bool get_redirection_ids(uint32_t *ids, size_t index) {
-	uint32_t i;
-	for (i = REDIRECTION_LEVEL - 1; ; i--) {
-		ids[i] = (index % 128);
-		index /= 128;
-		if (i == 0) break;
-	}
-	if (index > 0) return false;
-	else if (ids[0] >= ON_INODE_DIR_SIZE) return false;
-	else return true;
-}
-
-static block_sector_t get_inode_sector(const struct inode_disk *inode, size_t index, block_sector_t *parent, uint32_t *index_in_parent) {
-	uint32_t ids[REDIRECTION_LEVEL];
-	if (!get_redirection_ids(ids, index)) return (-1);
-	uint32_t i;
-	block_sector_t sector = inode->dir[ids[0]];
-	if (parent != NULL) (*parent) = (block_sector_t)(-1);
-	if (index_in_parent != NULL) (*index_in_parent) = ids[0];
-	for (i = 1; i < REDIRECTION_LEVEL; i++) {
-		void *handle = get_sector_handle(sector, false);
-		if (handle == NULL) return (-1);
-		block_sector_t *data = (block_sector_t*)get_sector_data(handle);
-		block_sector_t next_sector = data[ids[i]];
-		release_sector_handle(sector, handle, false, false);
-		if (parent != NULL) (*parent) = sector;
-		if (index_in_parent != NULL) (*index_in_parent) = ids[i];
-		sector = next_sector;
-	}
-	return sector;
-}
-static bool allocate_inode_sector(struct inode_disk *inode, size_t index) {
-	uint32_t ids[REDIRECTION_LEVEL];
-	if (!get_redirection_ids(ids, index)) return (-1);
-	uint32_t i;
-	block_sector_t sector = inode->dir[ids[0]];
-	bool last_sector_newly_allocated = false;
-	if (sector == (block_sector_t)(-1)) {
-		if (!free_map_allocate(1, inode->dir + ids[0])) return false;
-		else {
-			last_sector_newly_allocated = true;
-			sector = inode->dir[ids[0]];
+/* Returns true, if the data of INODE is metadata, whose changes are journaled:
+   a directory or the free map. */
+static bool inode_is_meta(const struct inode *inode) {
+	return ((inode->flags & INODE_FLAG_DIR) != 0 || inode->sector == FREE_MAP_SECTOR);
+}
+
+/* Returns true, if extent E of MAP holds data sector INDEX. */
+static bool extent_holds(const struct extent_map *map, size_t e, size_t index) {
+	return (e < map->cnt && index >= map->extents[e].first
+		&& index < map->extents[e].first + map->extents[e].length);
+}
+
+/* Returns the disk sector holding data sector INDEX according to MAP,
+   or -1, if there is none. The extent of the previous lookup and the one
+   after it are tried first, so that repeated and sequential accesses
+   skip the binary search over the extents. */
+static block_sector_t extent_map_lookup(struct extent_map *map, size_t index) {
+	size_t e = map->hint;
+	if (!extent_holds(map, e, index) && !extent_holds(map, ++e, index)) {
+		size_t lo = 0, hi = map->cnt;
+		while (true) {
+			if (lo >= hi) return (-1);
+			e = lo + (hi - lo) / 2;
+			if (index < map->extents[e].first) hi = e;
+			else if (index >= map->extents[e].first + map->extents[e].length) lo = e + 1;
+			else break;
 		}
 	}
-	for (i = 1; i < REDIRECTION_LEVEL; i++) {
-		void *handle = get_sector_handle(sector, true);
-		if (handle == NULL) return false;
-		block_sector_t *data = (block_sector_t*)get_sector_data(handle);
-		if (last_sector_newly_allocated) {
-			uint32_t j;
-			for (j = 0; j < 128; j++)
-				data[j] = (block_sector_t)(-1);
-		}
-		block_sector_t next_sector = data[ids[i]];
-		bool altered = false;
-		if (next_sector == (block_sector_t)(-1)) {
-			if (!free_map_allocate(1, data + ids[i])) {
-				release_sector_handle(sector, handle, false, true);
-				return false;
-			}
-			else {
-				altered = true;
-				next_sector = data[ids[i]];
-			}
-		}
-		release_sector_handle(sector, handle, altered, true);
-		sector = next_sector;
-		last_sector_newly_allocated = altered;
+	map->hint = e;
+	return (map->extents[e].start + (index - map->extents[e].first));
+}
+
+/* Returns the index of the first extent of MAP, that ends after data sector INDEX. */
+static size_t extent_map_find(const struct extent_map *map, size_t index) {
+	size_t lo = 0, hi = map->cnt;
+	while (lo < hi) {
+		size_t e = lo + (hi - lo) / 2;
+		if (map->extents[e].first + map->extents[e].length <= index) lo = e + 1;
+		else hi = e;
 	}
-	if (last_sector_newly_allocated) {
-		void *handle = get_sector_handle(sector, true);
-		if (handle == NULL) return false;
-		uint32_t *data = (uint32_t*)get_sector_data(handle);
-		for (i = 0; i < 128; i++)
-			data[i] = 0;
-		release_sector_handle(sector, handle, true, true);
+	return lo;
+}
+
+/* Returns true, if any of the data sectors FIRST...END - 1 is a hole in MAP. */
+static bool extent_map_has_hole(const struct extent_map *map, size_t first, size_t end) {
+	size_t e = extent_map_find(map, first);
+	while (first < end) {
+		if (e >= map->cnt || map->extents[e].first > first) return true;
+		first = map->extents[e].first + map->extents[e].length;
+		e++;
 	}
+	return false;
+}
+
+/* Inserts the run of CNT disk sectors from START, holding the data sectors
+   FIRST...FIRST + CNT - 1, as extent E of MAP. */
+static bool extent_map_insert(struct extent_map *map, size_t e, size_t first,
+		block_sector_t start, size_t cnt) {
+	if (map->cnt == map->capacity) {
+		size_t capacity = (map->capacity == 0) ? INODE_DIRECT_EXTENTS : (map->capacity * 2);
+		struct extent *extents = realloc(map->extents, capacity * sizeof(struct extent));
+		if (extents == NULL) return false;
+		map->extents = extents;
+		map->capacity = capacity;
+	}
+	memmove(map->extents + e + 1, map->extents + e, (map->cnt - e) * sizeof(struct extent));
+	map->extents[e].first = first;
+	map->extents[e].start = start;
+	map->extents[e].length = cnt;
+	map->cnt++;
+	if (first + cnt > map->sectors) map->sectors = first + cnt;
 	return true;
 }
 
-static void inode_dir_cleanup_clean_level(block_sector_t sector, uint32_t level) {
-	if (sector != (block_sector_t)(-1)) {
-		if (level < REDIRECTION_LEVEL) {
-			void *handle = get_sector_handle(sector, true);
-			if (handle != NULL) {
-				block_sector_t *data = (block_sector_t*)get_sector_data(handle);
-				uint32_t i;
-				for (i = 0; i < 128; i++)
-					inode_dir_cleanup_clean_level(data[i], level + 1);
-				release_sector_handle(sector, handle, false, true);
-			}
+/* Merges the extents of MAP from extent FROM on, that continue each other
+   both in the file and on the disk. */
+static void extent_map_coalesce(struct extent_map *map, size_t from) {
+	size_t i, j = from;
+	for (i = from + 1; i < map->cnt; i++) {
+		struct extent *last = map->extents + j;
+		const struct extent *e = map->extents + i;
+		if (last->first + last->length == e->first && last->start + last->length == e->start)
+			last->length += e->length;
+		else map->extents[++j] = *e;
+	}
+	if (map->cnt > 0) map->cnt = j + 1;
+	map->hint = 0;
+}
+
+/* Releases the data sectors of MAP from data sector SECTORS on. */
+static void extent_map_shrink(struct extent_map *map, size_t sectors) {
+	while (map->cnt > 0) {
+		struct extent *last = map->extents + map->cnt - 1;
+		if (last->first + last->length <= sectors) break;
+		size_t cnt = last->first + last->length - sectors;
+		if (cnt > last->length) cnt = last->length;
+		free_map_release(last->start + last->length - cnt, cnt);
+		last->length -= cnt;
+		if (last->length == 0) map->cnt--;
+	}
+	map->sectors = (map->cnt > 0) ? (map->extents[map->cnt - 1].first + map->extents[map->cnt - 1].length) : 0;
+	if (map->hint >= map->cnt) map->hint = 0;
+}
+
+static bool extent_map_store(const struct extent_map *map, struct inode_disk *disk, size_t from);
+
+/* Maps zeroed data sectors in the holes of MAP among the data sectors
+   FIRST...END - 1 and stores the changed extents in DISK. Each run is allocated
+   right after the extent before it (or after GOAL, at the start of a file) and as
+   long, as the free map allows, so a file written in order keeps continuing its
+   last extent. Data sectors KEEP_FIRST...KEEP_END - 1 are not zeroed, the caller
+   overwrites them completely. The zeroed sectors are journaled, if META is true.
+   On failure, nothing new stays allocated. */
+static bool extent_map_fill(struct extent_map *map, struct inode_disk *disk, block_sector_t goal,
+		size_t first, size_t end, size_t keep_first, size_t keep_end, bool meta) {
+	if (!extent_map_has_hole(map, first, end)) return true;
+
+	/* The old extents, to undo a failure with. */
+	struct extent_map old = { malloc((map->cnt + 1) * sizeof(struct extent)), map->cnt, map->cnt, map->sectors, 0 };
+	if (old.extents == NULL) return false;
+	memcpy(old.extents, map->extents, map->cnt * sizeof(struct extent));
+
+	size_t e = extent_map_find(map, first);
+	size_t from = (e > 0) ? (e - 1) : 0;  /* First extent, that may change. */
+	size_t index = first;
+	bool success = true;
+	while (index < end) {
+		if (e < map->cnt && map->extents[e].first <= index) {
+			index = map->extents[e].first + map->extents[e].length;
+			e++;
+			continue;
+		}
+		size_t hole_end = (e < map->cnt && map->extents[e].first < end) ? map->extents[e].first : end;
+		if (e > 0) goal = map->extents[e - 1].start + map->extents[e - 1].length;
+		block_sector_t start;
+		size_t cnt = free_map_allocate_near(goal, hole_end - index, &start);
+		if (cnt == 0 || !extent_map_insert(map, e, index, start, cnt)) {
+			if (cnt > 0) free_map_release(start, cnt);
+			success = false;
+			break;
+		}
+		size_t i;
+		for (i = 0; i < cnt; i++) {
+			if (index + i >= keep_first && index + i < keep_end) continue;
+			void *handle = meta ? get_meta_handle(start + i, true) : get_sector_handle(start + i, true);
+			memset(get_sector_data(handle), 0, BLOCK_SECTOR_SIZE);
+			if (meta) release_meta_handle(start + i, handle, true);
+			else release_sector_handle(start + i, handle, true, true);
+		}
+		index += cnt;
+		e++;
+	}
+	if (success) {
+		extent_map_coalesce(map, from);
+		success = extent_map_store(map, disk, from);
+	}
+	if (!success) {
+		/* Release the sectors mapped in the holes of the old extents. */
+		for (index = first; index < end; index++) {
+			block_sector_t sector = extent_map_lookup(map, index);
+			if (sector != (block_sector_t)(-1) && extent_map_lookup(&old, index) == (block_sector_t)(-1))
+				free_map_release(sector, 1);
 		}
-		free_map_release(sector, 1);
+		memcpy(map->extents, old.extents, old.cnt * sizeof(struct extent));
+		map->cnt = old.cnt;
+		map->sectors = old.sectors;
+		map->hint = 0;
+		extent_map_store(map, disk, from);
 	}
+	free(old.extents);
+	return success;
 }
-static void inode_dir_cleanup(struct inode_disk *inode) {
-	uint32_t i;
-	for (i = 0; i < ON_INODE_DIR_SIZE; i++) {
-		inode_dir_cleanup_clean_level(inode->dir[i], 1);
-		inode->dir[i] = (block_sector_t)(-1);
+
+/* Reads the extents of DISK into (uninitialized) MAP. */
+static bool extent_map_load(struct extent_map *map, const struct inode_disk *disk) {
+	map->extents = NULL;
+	map->cnt = map->capacity = map->sectors = map->hint = 0;
+	size_t cnt = disk->extent_cnt;
+	if (cnt == 0) return true;
+	map->extents = malloc(cnt * sizeof(struct extent));
+	if (map->extents == NULL) return false;
+	map->capacity = cnt;
+	map->cnt = (cnt < INODE_DIRECT_EXTENTS) ? cnt : INODE_DIRECT_EXTENTS;
+	memcpy(map->extents, disk->direct, map->cnt * sizeof(struct extent));
+	block_sector_t block = disk->extent_block;
+	while (map->cnt < cnt && block != (block_sector_t)(-1)) {
+		void *handle = get_sector_handle(block, false);
+		struct extent_block *data = (struct extent_block*)get_sector_data(handle);
+		size_t n = cnt - map->cnt;
+		if (n > EXTENT_BLOCK_EXTENTS) n = EXTENT_BLOCK_EXTENTS;
+		memcpy(map->extents + map->cnt, data->extents, n * sizeof(struct extent));
+		index_read_cnt++;
+		map->cnt += n;
+		block_sector_t next = data->next;
+		release_sector_handle(block, handle, false, false);
+		block = next;
+	}
+	if (map->cnt > 0) {
+		struct extent *last = map->extents + map->cnt - 1;
+		map->sectors = last->first + last->length;
 	}
+	return true;
 }
-static void deallocate_inode_sector(struct inode_disk *inode, size_t index) {
-	block_sector_t parent;
-	uint32_t index_in_parent;
-	block_sector_t sector = get_inode_sector(inode, index, &parent, &index_in_parent);
-	if (sector != (block_sector_t)(-1)) {
-		free_map_release(sector, 1);
-		if (parent != (block_sector_t)(-1)) {
-			void *handle = get_sector_handle(parent, true);
-			if (handle != NULL) {
-				block_sector_t *data = (block_sector_t*)get_sector_data(handle);
-				data[index_in_parent] = (block_sector_t)(-1);
-				release_sector_handle(sector, handle, true, true);
-			}
+
+/* Writes the extents of MAP with indices FROM and above into DISK and its
+   overflow extent blocks; the blocks are allocated, as needed. */
+static bool extent_map_store(const struct extent_map *map, struct inode_disk *disk, size_t from) {
+	disk->extent_cnt = map->cnt;
+	size_t i;
+	for (i = from; i < map->cnt && i < INODE_DIRECT_EXTENTS; i++)
+		disk->direct[i] = map->extents[i];
+	if (map->cnt <= INODE_DIRECT_EXTENTS) return true;
+
+	bool fresh = false;
+	if (disk->extent_block == (block_sector_t)(-1)) {
+		if (free_map_allocate_near(map->extents[map->cnt - 1].start, 1, &disk->extent_block) == 0)
+			return false;
+		fresh = true;
+	}
+	block_sector_t block = disk->extent_block;
+	size_t first = INODE_DIRECT_EXTENTS;
+	while (first < map->cnt) {
+		size_t end = first + EXTENT_BLOCK_EXTENTS;
+		if (end > map->cnt) end = map->cnt;
+		void *handle = get_meta_handle(block, true);
+		struct extent_block *data = (struct extent_block*)get_sector_data(handle);
+		bool changed = fresh;
+		if (fresh) data->next = (block_sector_t)(-1);
+		for (i = ((from > first) ? from : first); i < end; i++) {
+			data->extents[i - first] = map->extents[i];
+			changed = true;
 		}
-		else inode->dir[index_in_parent] = (block_sector_t)(-1);
+		bool success = true;
+		fresh = false;
+		if (end < map->cnt && data->next == (block_sector_t)(-1)) {
+			success = (free_map_allocate_near(block + 1, 1, &data->next) > 0);
+			changed = fresh = success;
+		}
+		block_sector_t next = data->next;
+		if (changed) release_meta_handle(block, handle, true);
+		else release_sector_handle(block, handle, false, true);
+		if (!success) return false;
+		block = next;
+		first = end;
 	}
+	return true;
+}
+
+/* Releases all the sectors of MAP and the extent blocks of DISK. */
+static void extent_map_release(struct extent_map *map, struct inode_disk *disk) {
+	extent_map_shrink(map, 0);
+	block_sector_t block = disk->extent_block;
+	while (block != (block_sector_t)(-1)) {
+		void *handle = get_sector_handle(block, false);
+		block_sector_t next = ((struct extent_block*)get_sector_data(handle))->next;
+		release_sector_handle(block, handle, false, false);
+		free_map_release(block, 1);
+		block = next;
+	}
+	disk->extent_block = (block_sector_t)(-1);
+	disk->extent_cnt = 0;
 }
 #endif
 
@@ -208,18 +459,17 @@ static void deallocate_inode_sector(struct inode_disk *inode, size_t index) {
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos, bool ignore_length) 
+byte_to_sector (struct inode *inode, off_t pos, bool ignore_length) 
 {
   ASSERT (inode != NULL);
   if (ignore_length || pos < inode->length) {
 #ifndef FILESYS
 	  return inode->data.start + pos / BLOCK_SECTOR_SIZE;
 #else
-      block_sector_t main_sector = inode->sector;
-      void *handle = get_sector_handle(main_sector, false);
-      struct inode_disk *data = (struct inode_disk *) get_sector_data(handle);
-	  block_sector_t seek = get_inode_sector(data, pos / BLOCK_SECTOR_SIZE, NULL, NULL);
-      release_sector_handle(main_sector, handle, false, false);
+      lookup_cnt++;
+      lock_acquire (&inode->map_lock);
+      block_sector_t seek = extent_map_lookup (&inode->map, pos / BLOCK_SECTOR_SIZE);
+      lock_release (&inode->map_lock);
       return seek;
 #endif
   }
@@ -227,15 +477,129 @@ byte_to_sector (const struct inode *inode, off_t pos, bool ignore_length)
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, hashed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;   /* Protects open_inodes; taken before inode locks. */
+static struct condition open_inodes_loaded; /* Signaled when an inode is done loading. */
+
+static unsigned
+open_inodes_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+static bool
+open_inodes_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
+#ifdef FILESYS
+/* Request for the read-ahead daemon. */
+struct readahead_request
+  {
+    struct inode *inode;                /* Reopened inode; closed by the daemon. */
+    size_t first;                       /* First data sector (index inside file). */
+    size_t cnt;                         /* Number of data sectors. */
+    struct list_elem elem;              /* Element in readahead_queue. */
+  };
+
+static struct list readahead_queue;     /* Pending read-ahead requests. */
+static size_t readahead_queued;         /* Length of readahead_queue. */
+static struct lock readahead_lock;      /* Protects the queue. */
+static struct semaphore readahead_sem;  /* Upped for every queued request. */
+
+/* Loads the data sectors of the queued requests into the buffer cache. */
+static void
+readahead_daemon (void *aux UNUSED)
+{
+  while (true)
+    {
+      sema_down (&readahead_sem);
+      lock_acquire (&readahead_lock);
+      struct readahead_request *req = list_entry (list_pop_front (&readahead_queue),
+                                                  struct readahead_request, elem);
+      readahead_queued--;
+      lock_release (&readahead_lock);
+
+      size_t i;
+      for (i = 0; i < req->cnt; i++)
+        {
+          block_sector_t sector = byte_to_sector (req->inode,
+              (req->first + i) * BLOCK_SECTOR_SIZE, false);
+          if (sector != (block_sector_t)(-1))
+            cache_prefetch (sector);
+        }
+      inode_close (req->inode);
+      free (req);
+    }
+}
+
+/* Notes the read of SIZE bytes at OFFSET from INODE and, if the
+   inode is being read sequentially, asks the read-ahead daemon for
+   the data sectors following the read.  Requests are batched by
+   READAHEAD_SECTORS / 2 sectors. */
+static void
+inode_readahead (struct inode *inode, off_t offset, off_t size)
+{
+  bool sequential = (offset == inode->read_end);
+  inode->read_end = offset + size;
+  if (!sequential)
+    {
+      inode->readahead_next = 0;
+      return;
+    }
+
+  size_t first = offset / BLOCK_SECTOR_SIZE + 1;
+  size_t end = bytes_to_sectors (offset + size) + READAHEAD_SECTORS;
+  if (end > bytes_to_sectors (inode->length))
+    end = bytes_to_sectors (inode->length);
+  if (first < inode->readahead_next)
+    first = inode->readahead_next;
+  if (first >= end || (end - first < READAHEAD_SECTORS / 2
+                       && end < bytes_to_sectors (inode->length)))
+    return;
+
+  struct readahead_request *req = malloc (sizeof *req);
+  if (req == NULL)
+    return;
+  lock_acquire (&readahead_lock);
+  if (readahead_queued >= READAHEAD_QUEUE_MAX)
+    {
+      lock_release (&readahead_lock);
+      free (req);
+      return;
+    }
+  req->inode = inode_reopen (inode);
+  req->first = first;
+  req->cnt = end - first;
+  list_push_back (&readahead_queue, &req->elem);
+  readahead_queued++;
+  lock_release (&readahead_lock);
+  sema_up (&readahead_sem);
+  inode->readahead_next = end;
+}
+#endif
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, open_inodes_hash, open_inodes_less, NULL))
+    PANIC ("can't initialize the open inode table");
+  lock_init (&open_inodes_lock);
+  cond_init (&open_inodes_loaded);
+#ifdef FILESYS
+  list_init (&readahead_queue);
+  readahead_queued = 0;
+  lock_init (&readahead_lock);
+  sema_init (&readahead_sem, 0);
+  tid_t tid = thread_create ("read-ahead", PRI_DEFAULT, readahead_daemon, NULL);
+  ASSERT (tid != TID_ERROR);
+#endif
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -254,6 +618,7 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct extent_block) == BLOCK_SECTOR_SIZE);
 
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
@@ -261,7 +626,10 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
 	  size_t sectors = bytes_to_sectors(length);
 	  disk_inode->length = length;
 	  disk_inode->magic = INODE_MAGIC;
-      disk_inode->flags = (uint32_t) is_dir;
+      disk_inode->flags = is_dir ? INODE_FLAG_DIR : 0;
+#ifdef FILESYS
+      disk_inode->version = INODE_FORMAT_VERSION;
+#endif
 #ifndef FILESYS
 	  if (free_map_allocate(sectors, &disk_inode->start))
 	  {
@@ -277,23 +645,21 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
 		  success = true;
 	  }
 #else
-	  size_t i;
-	  for (i = 0; i < ON_INODE_DIR_SIZE; i++)
-		  disk_inode->dir[i] = -1;
-	  success = true;
-	  for (i = 0; i < sectors; i++)
-		  if (!allocate_inode_sector(disk_inode, i)) {
-			  success = false;
-			  break;
-		  }
+	  struct extent_map map = { NULL, 0, 0, 0, 0 };
+	  disk_inode->extent_block = (block_sector_t)(-1);
+	  /* The data of a file is allocated, as it is written; directories
+	     and the free map are never sparse. */
+	  bool meta = (is_dir || sector == FREE_MAP_SECTOR);
+	  success = (!meta || extent_map_fill(&map, disk_inode, sector + 1, 0, sectors, 0, 0, true));
 	  if (success){
           block_sector_t main_sector = sector;
-          void *handle = get_sector_handle(main_sector, true);
+          void *handle = get_meta_handle(main_sector, true);
           struct inode_disk *data = (struct inode_disk *) get_sector_data(handle);
           memcpy(data, disk_inode, sizeof(struct inode_disk));
-          release_sector_handle(main_sector, handle, true, true);
+          release_meta_handle(main_sector, handle, true);
       }
-	  else inode_dir_cleanup(disk_inode);
+	  else extent_map_release(&map, disk_inode);
+	  free(map.extents);
 #endif
       free (disk_inode);
     }
@@ -306,40 +672,74 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
-  
 
-  
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  /* Check whether this inode is already open.  An inode, that is
+     still being loaded, is waited for; if its loading fails, it is
+     gone from the table when we look again. */
+  key.sector = sector;
+  lock_acquire (&open_inodes_lock);
+  while ((e = hash_find (&open_inodes, &key.elem)) != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      inode = hash_entry (e, struct inode, elem);
+      if (!inode->loading)
         {
-          inode_reopen (inode);
-          return inode; 
+          inode = inode_reopen (inode);
+          lock_release (&open_inodes_lock);
+          return inode;
         }
+      cond_wait (&open_inodes_loaded, &open_inodes_lock);
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  void *handle = get_sector_handle(sector, true);
-  struct inode_disk *data = (struct inode_disk *) get_sector_data(handle);
-  inode->is_dir = data->flags;
-  inode->length = data->length;
-  release_sector_handle(sector, handle, false, true);
+  /* Initialize, and put the inode in the table as a placeholder, so
+     that the table is not locked while it is read from disk, and
+     concurrent openers of the same sector wait for it. */
+  lock_init (&inode->map_lock);
+  lock_init (&inode->lock);
+  lock_init (&inode->dir_lock);
+  rwlock_init (&inode->rw);
+  lock_init (&inode->grow_lock);
 
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
+  inode->loading = true;
   inode->deny_write_cnt = 0;
   inode->removed = false;
+  inode->read_end = 0;
+  inode->readahead_next = 0;
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  void *handle = get_sector_handle(sector, true);
+  struct inode_disk *data = (struct inode_disk *) get_sector_data(handle);
+  inode->flags = data->flags;
+  inode->length = data->length;
+  bool loaded = extent_map_load(&inode->map, data);
+  release_sector_handle(sector, handle, false, true);
+
+  lock_acquire (&open_inodes_lock);
+  index_read_cnt++;
+  if (loaded)
+    inode->loading = false;
+  else
+    hash_delete (&open_inodes, &inode->elem);
+  cond_broadcast (&open_inodes_loaded, &open_inodes_lock);
+  lock_release (&open_inodes_lock);
+  if (!loaded)
+    {
+      free (inode);
+      return NULL;
+    }
   return inode;
 }
 
@@ -348,7 +748,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&inode->lock);
+      inode->open_cnt++;
+      lock_release (&inode->lock);
+    }
   return inode;
 }
 
@@ -369,28 +773,38 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
+  /* The table is locked, so that nobody reopens the inode, after
+     its last opener has closed it. */
+  lock_acquire (&open_inodes_lock);
+  lock_acquire (&inode->lock);
+  bool last = (--inode->open_cnt == 0);
+  lock_release (&inode->lock);
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          journal_begin ();
 #ifndef FILESYS
           free_map_release (inode->data.start,
                             bytes_to_sectors (inode->data.length));
 #else
           block_sector_t main_sector = inode->sector;
-          void *handle = get_sector_handle(main_sector, true);
+          void *handle = get_meta_handle(main_sector, true);
           struct inode_disk *data = (struct inode_disk *) get_sector_data(handle);
-		  inode_dir_cleanup(data);
-          release_sector_handle(main_sector, handle, true, true);
+          extent_map_release(&inode->map, data);
+          release_meta_handle(main_sector, handle, true);
 #endif
           free_map_release (inode->sector, 1);
+          journal_end ();
         }
 
+      free (inode->map.extents);
       free (inode); 
     }
 }
@@ -401,18 +815,135 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&inode->lock);
   inode->removed = true;
+  lock_release (&inode->lock);
+}
+
+/* Position in the buffers of a vectored read or write. */
+struct iov_cursor
+  {
+    const struct iovec *iov;            /* Current buffer. */
+    size_t ofs;                         /* Offset in the current buffer. */
+  };
+
+/* Returns the total length of the CNT buffers in IOV. */
+static off_t
+iov_length (const struct iovec *iov, size_t cnt)
+{
+  off_t size = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    size += iov[i].iov_len;
+  return size;
+}
+
+/* Moves C past the buffers, that it is at the end of.  There must
+   be bytes left in the buffers after C. */
+static void
+iov_normalize (struct iov_cursor *c)
+{
+  while (c->ofs == c->iov->iov_len)
+    {
+      c->iov++;
+      c->ofs = 0;
+    }
+}
+
+/* Returns the next SIZE bytes at C, if they are contiguous, and
+   advances C past them, otherwise returns a null pointer. */
+static uint8_t *
+iov_span (struct iov_cursor *c, size_t size)
+{
+  uint8_t *span;
+
+  iov_normalize (c);
+  if (c->iov->iov_len - c->ofs < size)
+    return NULL;
+  span = (uint8_t *) c->iov->iov_base + c->ofs;
+  c->ofs += size;
+  return span;
+}
+
+/* Copies SIZE bytes from SRC, or zeros if SRC is a null pointer,
+   into the buffers at C and advances C past them. */
+static void
+iov_copy_out (struct iov_cursor *c, const uint8_t *src, size_t size)
+{
+  while (size > 0)
+    {
+      iov_normalize (c);
+      size_t n = c->iov->iov_len - c->ofs;
+      uint8_t *dst = (uint8_t *) c->iov->iov_base + c->ofs;
+      if (n > size)
+        n = size;
+      if (src != NULL)
+        {
+          memcpy (dst, src, n);
+          src += n;
+        }
+      else
+        memset (dst, 0, n);
+      c->ofs += n;
+      size -= n;
+    }
+}
+
+/* Copies SIZE bytes from the buffers at C into DST and advances
+   C past them. */
+static void
+iov_copy_in (struct iov_cursor *c, uint8_t *dst, size_t size)
+{
+  while (size > 0)
+    {
+      iov_normalize (c);
+      size_t n = c->iov->iov_len - c->ofs;
+      if (n > size)
+        n = size;
+      memcpy (dst, (const uint8_t *) c->iov->iov_base + c->ofs, n);
+      dst += n;
+      c->ofs += n;
+      size -= n;
+    }
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size > 0 ? size : 0;
+  return inode_readv_at (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOV_CNT buffers in IOV, one after
+   another, starting at position OFFSET, in a single pass over the
+   sectors.  Returns the number of bytes actually read, which may
+   be less than their total length if an error occurs or end of
+   file is reached. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, size_t iov_cnt,
+                off_t offset) 
 {
-  uint8_t *buffer = buffer_;
+  struct iov_cursor cursor = { iov, 0 };
+  off_t size = iov_length (iov, iov_cnt);
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
+  uint8_t *direct;
+
+  ASSERT (offset >= 0);
+
+#ifdef FILESYS
+  bool stream = (size >= STREAM_MIN_BYTES);
+  if (!stream)
+    inode_readahead (inode, offset, size);
+  rwlock_acquire_read (&inode->rw);
+#endif
 
   while (size > 0) 
     {
@@ -431,22 +962,40 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
         break;
 
 #ifdef FILESYS
-	  void *handle = get_sector_handle(sector_idx, false);
+      if (sector_idx == (block_sector_t)(-1))
+        {
+          /* A hole reads as zeros. */
+          iov_copy_out (&cursor, NULL, chunk_size);
+          size -= chunk_size;
+          offset += chunk_size;
+          bytes_read += chunk_size;
+          continue;
+        }
+      if (stream && sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE
+          && (direct = iov_span (&cursor, BLOCK_SECTOR_SIZE)) != NULL)
+        {
+          /* Read the sector straight into caller's buffer. */
+          cache_read_through (sector_idx, direct);
+          size -= chunk_size;
+          offset += chunk_size;
+          bytes_read += chunk_size;
+          continue;
+        }
+      /* The sector is locked, so that a concurrent write into it
+         is seen either whole or not at all. */
+	  void *handle = get_sector_handle(sector_idx, true);
 	  bounce = (uint8_t*)get_sector_data(handle);
-#endif
-
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      iov_copy_out (&cursor, bounce + sector_ofs, chunk_size);
+	  release_sector_handle(sector_idx, handle, false, true);
+#else
+      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE
+          && (direct = iov_span (&cursor, BLOCK_SECTOR_SIZE)) != NULL)
         {
-#ifndef FILESYS
           /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-#else
-		  memcpy(buffer + bytes_read, bounce, BLOCK_SECTOR_SIZE);
-#endif
+          block_read (fs_device, sector_idx, direct);
         }
       else 
         {
-#ifndef FILESYS
           /* Read sector into bounce buffer, then partially copy
              into caller's buffer. */
           if (bounce == NULL) 
@@ -456,11 +1005,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
                 break;
             }
           block_read (fs_device, sector_idx, bounce);
-#endif
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          iov_copy_out (&cursor, bounce + sector_ofs, chunk_size);
         }
-#ifdef FILESYS
-	  release_sector_handle(sector_idx, handle, false, false);
 #endif
       
       /* Advance. */
@@ -470,6 +1016,9 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
     }
 #ifndef FILESYS
   free (bounce);
+#else
+  rwlock_release_read (&inode->rw);
+  read_byte_cnt += bytes_read;
 #endif
 
   return bytes_read;
@@ -478,53 +1027,88 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   A write past the end of the file extends it. */
+off_t
+inode_write_at(struct inode *inode, const void *buffer, off_t size,
+	off_t offset)
+{
+	struct iovec iov;
+	iov.iov_base = (void *) buffer;
+	iov.iov_len = (size > 0) ? size : 0;
+	return inode_writev_at(inode, &iov, 1, offset);
+}
+
+/* Writes the IOV_CNT buffers in IOV, one after another, into INODE,
+   starting at OFFSET, in a single pass over the sectors. Returns the
+   number of bytes actually written, which may be less than their
+   total length if an error occurs. */
 off_t
-inode_write_at(struct inode *inode, const void *buffer_, off_t size,
+inode_writev_at(struct inode *inode, const struct iovec *iov, size_t iov_cnt,
 	off_t offset)
 {
-	const uint8_t *buffer = buffer_;
+	struct iov_cursor cursor = { iov, 0 };
+	off_t size = iov_length(iov, iov_cnt);
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
+	uint8_t *direct;
+
+	ASSERT(offset >= 0);
 
 	if (inode->deny_write_cnt)
 		return 0;
 
 #ifdef FILESYS
+	/* Changes of the metadata are journaled: those of a directory or
+	   the free map always, those of a file only, if it grows or has
+	   holes filled. A file gets only the data sectors written to,
+	   a directory or the free map all of them up to its end.
+	   Reads and writes share the inode; only filling holes excludes
+	   them, so that nobody sees a new sector before it is zeroed,
+	   and the writes that extend the file are serialized. The new
+	   sectors, that the write covers completely, are not zeroed; if
+	   any of them is inside the file, the readers stay excluded,
+	   until the data is written. */
+	bool meta = inode_is_meta(inode);
+	bool stream = (size >= STREAM_MIN_BYTES && !meta);
 	off_t min_size = offset + size;
-	off_t start = bytes_to_sectors(inode->length);
-	off_t end = bytes_to_sectors(min_size);
-	bool file_grown = false;
-	void *main_handle = NULL;
-	struct inode_disk *data = NULL;
+	size_t first = offset / BLOCK_SECTOR_SIZE;
+	size_t end = (size > 0) ? bytes_to_sectors(min_size) : first;
 	block_sector_t main_sector = inode->sector;
-	main_handle = get_sector_handle(main_sector, true);
-	data = (struct inode_disk *) get_sector_data(main_handle);
-	off_t inode_cur_length = inode->length;
-	if (inode->length < min_size) {
-		off_t ptr = start;
-		while (ptr < end) {
-			if (!allocate_inode_sector(data, ptr))
-				break;
-			ptr++;
-		}
-		if (ptr >= end) {
-			inode_cur_length = min_size;
-			file_grown = true;
-		}
-		else {
-			end = ptr;
-			ptr = start;
-			while (ptr < end) {
-				deallocate_inode_sector(data, ptr);
-				ptr++;
-			}
-			release_sector_handle(main_sector, main_handle, true, true);
+	bool growing = (inode_length(inode) < min_size);
+	if (growing) {
+		lock_acquire(&inode->grow_lock);
+		growing = (inode->length < min_size);
+		if (!growing) lock_release(&inode->grow_lock);
+	}
+	lock_acquire(&inode->map_lock);
+	if (meta && first > inode->map.sectors) first = inode->map.sectors;
+	bool holes = extent_map_has_hole(&inode->map, first, end);
+	lock_release(&inode->map_lock);
+	bool changing = (growing || holes);
+	bool exclusive = false;
+	if (changing) journal_begin();
+	if (holes) {
+		size_t keep_first = DIV_ROUND_UP(offset, BLOCK_SECTOR_SIZE);
+		size_t keep_end = min_size / BLOCK_SECTOR_SIZE;
+		void *main_handle = get_meta_handle(main_sector, true);
+		struct inode_disk *data = (struct inode_disk *) get_sector_data(main_handle);
+		rwlock_acquire_write(&inode->rw);
+		lock_acquire(&inode->map_lock);
+		bool filled = extent_map_fill(&inode->map, data, inode->sector + 1, first, end,
+			keep_first, keep_end, meta);
+		lock_release(&inode->map_lock);
+		exclusive = (filled && keep_first < keep_end
+			&& (off_t) (keep_first * BLOCK_SECTOR_SIZE) < inode->length);
+		if (!exclusive) rwlock_release_write(&inode->rw);
+		release_meta_handle(main_sector, main_handle, true);
+		if (!filled) {
+			journal_end();
+			if (growing) lock_release(&inode->grow_lock);
 			return 0;
 		}
 	}
-	else release_sector_handle(main_sector, main_handle, true, true);
+	off_t inode_cur_length = growing ? min_size : inode->length;
+	if (!exclusive) rwlock_acquire_read(&inode->rw);
 #endif
 
 	while (size > 0)
@@ -543,21 +1127,31 @@ inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 #ifdef FILESYS
-		void *handle = get_sector_handle(sector_idx, false);
+		if (stream && sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE
+			&& (direct = iov_span(&cursor, BLOCK_SECTOR_SIZE)) != NULL) {
+			/* Write the sector straight from caller's buffer. */
+			cache_write_through(sector_idx, direct);
+			size -= chunk_size;
+			offset += chunk_size;
+			bytes_written += chunk_size;
+			continue;
+		}
+		/* Data is copied in with the sector locked, so that concurrent
+		   reads see the chunk either whole or not at all. */
+		void *handle = meta ? get_meta_handle(sector_idx, false) : get_sector_handle(sector_idx, true);
 		bounce = (uint8_t*)get_sector_data(handle);
-#endif
-		if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+		iov_copy_in(&cursor, bounce + sector_ofs, chunk_size);
+		if (meta) release_meta_handle(sector_idx, handle, false);
+		else release_sector_handle(sector_idx, handle, true, true);
+#else
+		if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE
+			&& (direct = iov_span(&cursor, BLOCK_SECTOR_SIZE)) != NULL)
 		{
-#ifndef FILESYS
 			/* Write full sector directly to disk. */
-			block_write(fs_device, sector_idx, buffer + bytes_written);
-#else
-			memcpy(bounce, buffer + bytes_written, BLOCK_SECTOR_SIZE);
-#endif
+			block_write(fs_device, sector_idx, direct);
 		}
 		else
 		{
-#ifndef FILESYS
 			/* We need a bounce buffer. */
 			if (bounce == NULL)
 			{
@@ -573,16 +1167,9 @@ inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 				block_read(fs_device, sector_idx, bounce);
 			else
 				memset(bounce, 0, BLOCK_SECTOR_SIZE);
-			memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
+			iov_copy_in(&cursor, bounce + sector_ofs, chunk_size);
 			block_write(fs_device, sector_idx, bounce);
-#else
-			if (!(sector_ofs > 0 || chunk_size < sector_left))
-				memset(bounce, 0, BLOCK_SECTOR_SIZE);
-			memcpy(bounce + sector_ofs, buffer + bytes_written, chunk_size);
-#endif
 		}
-#ifdef FILESYS
-		release_sector_handle(sector_idx, handle, true, false);
 #endif
 
 		/* Advance. */
@@ -594,23 +1181,67 @@ inode_write_at(struct inode *inode, const void *buffer_, off_t size,
 #ifndef FILESYS
 	free(bounce);
 #else
-	if (file_grown) {
-		data->length = min_size;
-		inode->length = data->length;
-		release_sector_handle(main_sector, main_handle, true, true);
+	if (exclusive) rwlock_release_write(&inode->rw);
+	else rwlock_release_read(&inode->rw);
+	if (growing) {
+		/* The new length is published after the data, so readers never see
+		   the end of the file before it is written. */
+		void *main_handle = get_meta_handle(main_sector, true);
+		((struct inode_disk *) get_sector_data(main_handle))->length = min_size;
+		release_meta_handle(main_sector, main_handle, true);
+		lock_acquire(&inode->lock);
+		inode->length = min_size;
+		lock_release(&inode->lock);
+		lock_release(&inode->grow_lock);
 	}
+	if (changing)
+		journal_end();
 #endif
 
   return bytes_written;
 }
 
+/* Pins the data sector of INODE, that holds byte offset OFS, in
+   the buffer cache and describes it in *REF, so that a caller can
+   go over all of it, without a cache lookup per access.  The data
+   must not be modified.  Returns false if OFS is past the end of
+   INODE.  The sector has to be unpinned with inode_unpin_sector(). */
+bool
+inode_pin_sector (struct inode *inode, off_t ofs, struct inode_sector_ref *ref)
+{
+#ifdef FILESYS
+  ref->sector = byte_to_sector (inode, ofs, false);
+  if (ref->sector == (block_sector_t)(-1))
+    return false;
+  ref->handle = get_sector_handle (ref->sector, false);
+  ref->data = (const uint8_t *) get_sector_data (ref->handle);
+  return true;
+#else
+  (void) inode; (void) ofs; (void) ref;
+  return false;
+#endif
+}
+
+/* Unpins the sector, pinned by inode_pin_sector(). */
+void
+inode_unpin_sector (struct inode_sector_ref *ref)
+{
+#ifdef FILESYS
+  release_sector_handle (ref->sector, ref->handle, false, false);
+#else
+  (void) ref;
+#endif
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&inode->lock);
 }
 
 /* Re-enables writes to INODE.
@@ -619,9 +1250,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  lock_acquire (&inode->lock);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  lock_release (&inode->lock);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -631,12 +1264,236 @@ inode_length (const struct inode *inode)
   return inode->length;
 }
 
+#ifdef FILESYS
+/* Growable array of sector numbers, collected for inode_flush(). */
+struct sector_array
+  {
+    block_sector_t *sectors;
+    size_t cnt;
+    size_t capacity;
+  };
+
+static bool
+sector_array_push (struct sector_array *arr, block_sector_t sector)
+{
+  if (arr->cnt == arr->capacity)
+    {
+      size_t capacity = (arr->capacity == 0) ? 64 : (arr->capacity * 2);
+      block_sector_t *sectors = realloc (arr->sectors, capacity * sizeof (block_sector_t));
+      if (sectors == NULL)
+        return false;
+      arr->sectors = sectors;
+      arr->capacity = capacity;
+    }
+  arr->sectors[arr->cnt++] = sector;
+  return true;
+}
+
+#endif
+
+/* Makes INODE durable: writes the dirty cached sectors of its data back
+   to the disk, commits the journal, so that its length and extents are
+   in the log, and then writes the inode itself and its extent blocks
+   back, each in ascending sector order.  The data goes first, so that a
+   committed extent never refers to data, that did not reach the disk.
+   Must not be called with a journal handle open. */
+void
+inode_flush (struct inode *inode)
+{
+#ifdef FILESYS
+  struct sector_array arr = { NULL, 0, 0 };
+  size_t i, j;
+
+  lock_acquire (&inode->map_lock);
+  for (i = 0; i < inode->map.cnt; i++)
+    {
+      const struct extent *e = inode->map.extents + i;
+      for (j = 0; j < e->length; j++)
+        if (!sector_array_push (&arr, e->start + j))
+          break;
+    }
+  lock_release (&inode->map_lock);
+  cache_flush_sectors (arr.sectors, arr.cnt);
+
+  journal_sync ();
+
+  arr.cnt = 0;
+  sector_array_push (&arr, inode->sector);
+  void *handle = get_sector_handle (inode->sector, false);
+  block_sector_t block = ((struct inode_disk *) get_sector_data (handle))->extent_block;
+  release_sector_handle (inode->sector, handle, false, false);
+  while (block != (block_sector_t)(-1) && sector_array_push (&arr, block))
+    {
+      handle = get_sector_handle (block, false);
+      block_sector_t next = ((struct extent_block *) get_sector_data (handle))->next;
+      release_sector_handle (block, handle, false, false);
+      block = next;
+    }
+  cache_flush_sectors (arr.sectors, arr.cnt);
+  free (arr.sectors);
+#else
+  (void) inode;
+#endif
+}
+
+#ifdef FILESYS
+/* Returns true, if the inode in SECTOR is in the current on-disk format. */
+bool
+inode_format_ok (block_sector_t sector)
+{
+  void *handle = get_sector_handle (sector, false);
+  const struct inode_disk *data = (const struct inode_disk *) get_sector_data (handle);
+  bool ok = (data->magic == INODE_MAGIC && data->version == INODE_FORMAT_VERSION);
+  release_sector_handle (sector, handle, false, false);
+  return ok;
+}
+
+/* Prints inode statistics. */
+void
+inode_print_stats (void)
+{
+  printf ("Inode: %llu lookups, %llu index sector reads, %llu bytes read\n",
+          lookup_cnt, index_read_cnt, read_byte_cnt);
+}
+#endif
+
 /* Returns byte indicates whether data encapsulated by inode
    represents file system directory on not */
 bool 
 inode_is_dir(const struct inode *inode)
 {
-  return (inode->is_dir);
+  return (inode->flags & INODE_FLAG_DIR) != 0;
+}
+
+/* Returns true if directory INODE is in the hashed format. */
+bool
+inode_is_hashed_dir (const struct inode *inode)
+{
+  return (inode->flags & INODE_FLAG_HASHED_DIR) != 0;
+}
+
+/* Replaces the data of directory INODE by the SIZE bytes of BUCKETS
+   and marks it as being in the hashed format, so that a crash leaves
+   either the old directory or the new one.  The buckets are too many
+   sectors for a journal transaction, so they are written to new
+   sectors, that nothing refers to yet, and are on the disk, before
+   the inode is switched over to them in a single transaction; the
+   old sectors are released after.  A crash in between leaks sectors
+   at worst.  Returns true if successful, false on failure, which
+   leaves the directory as it was.  The directory has to be locked. */
+bool
+inode_rehash_dir (struct inode *inode, const void *buckets, off_t size)
+{
+  ASSERT (inode_is_dir (inode));
+  ASSERT (size >= inode->length);
+#ifdef FILESYS
+  const uint8_t *data = buckets;
+  size_t sectors = bytes_to_sectors (size);
+  struct extent_map fresh = { NULL, 0, 0, 0, 0 };
+  struct extent_map old = { NULL, 0, 0, 0, 0 };
+  struct sector_array written = { NULL, 0, 0 };
+  block_sector_t goal = inode->sector + 1;
+  size_t index = 0, i;
+  bool success = true;
+
+  lock_acquire (&inode->grow_lock);
+  journal_begin ();
+  while (success && index < sectors)
+    {
+      block_sector_t start;
+      size_t cnt = free_map_allocate_near (goal, sectors - index, &start);
+      if (cnt == 0 || !extent_map_insert (&fresh, fresh.cnt, index, start, cnt))
+        {
+          if (cnt > 0)
+            free_map_release (start, cnt);
+          success = false;
+          break;
+        }
+      for (i = 0; i < cnt; i++)
+        {
+          void *handle = get_sector_handle (start + i, true);
+          memcpy (get_sector_data (handle), data + (index + i) * BLOCK_SECTOR_SIZE,
+                  BLOCK_SECTOR_SIZE);
+          if (!release_fresh_handle (start + i, handle)
+              && !sector_array_push (&written, start + i))
+            success = false;
+        }
+      goal = start + cnt;
+      index += cnt;
+    }
+  if (success)
+    cache_flush_sectors (written.sectors, written.cnt);
+  free (written.sectors);
+
+  if (success)
+    {
+      /* The inode, its extent blocks and the free map sectors of new
+         extent blocks. */
+      size_t blocks = (fresh.cnt > INODE_DIRECT_EXTENTS)
+        ? DIV_ROUND_UP (fresh.cnt - INODE_DIRECT_EXTENTS, EXTENT_BLOCK_EXTENTS) : 0;
+      journal_reserve (1 + 2 * blocks);
+      void *handle = get_meta_handle (inode->sector, true);
+      struct inode_disk *disk = (struct inode_disk *) get_sector_data (handle);
+      rwlock_acquire_write (&inode->rw);
+      lock_acquire (&inode->map_lock);
+      old = inode->map;
+      inode->map = fresh;
+      success = extent_map_store (&inode->map, disk, 0);
+      if (success)
+        {
+          disk->length = size;
+          disk->flags |= INODE_FLAG_HASHED_DIR;
+          lock_acquire (&inode->lock);
+          inode->length = size;
+          inode->flags |= INODE_FLAG_HASHED_DIR;
+          lock_release (&inode->lock);
+        }
+      else
+        {
+          inode->map = old;
+          extent_map_store (&inode->map, disk, 0);
+        }
+      lock_release (&inode->map_lock);
+      rwlock_release_write (&inode->rw);
+      release_meta_handle (inode->sector, handle, true);
+    }
+
+  /* Release the sectors of whichever directory did not make it. */
+  if (success)
+    {
+      extent_map_shrink (&old, 0);
+      free (old.extents);
+    }
+  else
+    {
+      extent_map_shrink (&fresh, 0);
+      free (fresh.extents);
+    }
+  lock_release (&inode->grow_lock);
+  journal_end ();
+  return success;
+#else
+  if (inode_write_at (inode, buckets, size, 0) != size)
+    return false;
+  lock_acquire (&inode->lock);
+  inode->flags |= INODE_FLAG_HASHED_DIR;
+  lock_release (&inode->lock);
+  return true;
+#endif
+}
+
+/* Locks directory INODE for a directory operation. */
+void
+inode_lock_dir (struct inode *inode)
+{
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Unlocks directory INODE. */
+void
+inode_unlock_dir (struct inode *inode)
+{
+  lock_release (&inode->dir_lock);
 }
 
 /* Returns true if inode is set to be removed from disk. */
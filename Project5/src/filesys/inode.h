@@ -2,11 +2,22 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <iovec.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
 
+/* A data sector of an inode, pinned in the buffer cache
+   (see inode_pin_sector()). */
+struct inode_sector_ref
+  {
+    block_sector_t sector;      /* Disk sector. */
+    void *handle;               /* Buffer cache handle. */
+    const uint8_t *data;        /* BLOCK_SECTOR_SIZE bytes of data. */
+  };
+
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool);
 struct inode *inode_open (block_sector_t);
@@ -16,10 +27,23 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, size_t iov_cnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, size_t iov_cnt,
+                       off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 bool inode_is_dir(const struct inode *);
+bool inode_is_hashed_dir (const struct inode *);
+bool inode_rehash_dir (struct inode *, const void *buckets, off_t size);
+void inode_lock_dir (struct inode *);
+void inode_unlock_dir (struct inode *);
 bool inode_is_removed(const struct inode *);
+void inode_flush (struct inode *);
+bool inode_pin_sector (struct inode *, off_t, struct inode_sector_ref *);
+void inode_unpin_sector (struct inode_sector_ref *);
+bool inode_format_ok (block_sector_t);
+void inode_print_stats (void);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,534 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Redo journal of the file system metadata.
+
+   Every change of a metadata sector (an inode, an extent block, or
+   a sector of a directory or of the free map) joins the running
+   transaction, and the sector stays pinned in the buffer cache, so
+   that it never reaches its home location before the transaction is
+   committed.  A transaction is committed by writing a header and the
+   images of all of its sectors to the log in one sequential write,
+   after which the sectors are unpinned and written back by the cache
+   as usual.  After a crash, the committed transactions are replayed
+   from the log, which leaves the metadata as it was after the last
+   of them.
+
+   Operations, that must be atomic, are bracketed by journal_begin()
+   and journal_end(); a transaction is only committed with no such
+   handles open, except when it outgrows its limit, which no single
+   operation comes close to: a directory rehash writes its buckets
+   to new sectors outside of the journal, and journals only the
+   switch of the inode to them (see inode_rehash_dir()).  Such a
+   switch reserves room in the transaction with journal_reserve(),
+   so that it is not split by an overflow.  Transactions are
+   committed in groups: when they reach half of their limit, by the
+   commit daemon and on shutdown.
+
+   Once the log is nearly full, it is checkpointed: the logged
+   sectors are written back to their home locations, and the log is
+   restarted from its beginning.
+
+   A logged sector, that is freed before the next checkpoint, may be
+   reused for file data, which is not journaled.  So that its old
+   image is not replayed over that data, the free map revokes it:
+   the sector is named in the header of the running transaction,
+   and replay skips the images of it in that transaction and in
+   the ones before. */
+
+/* Identifies the journal superblock and the transaction headers. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Most sectors in a transaction; with its header, half of the log. */
+#define JOURNAL_TX_MAX (JOURNAL_LOG_SECTORS / 2 - 1)
+
+/* Most sectors named in a transaction header, logged or revoked. */
+#define JOURNAL_HEADER_SECTORS 123
+
+/* Most sectors revoked by a transaction. */
+#define JOURNAL_REVOKE_MAX (JOURNAL_HEADER_SECTORS - JOURNAL_TX_MAX)
+
+/* Timer ticks between the commits of the commit daemon. */
+#define JOURNAL_COMMIT_TICKS 200
+
+/* First sector of the log and the end of it. */
+#define LOG_START (JOURNAL_SECTOR + 1)
+#define LOG_END (LOG_START + JOURNAL_LOG_SECTORS)
+
+/* Journal superblock, at JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_super
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Sequence number of the transaction at LOG_START. */
+    uint32_t unused[126];               /* Not used. */
+  };
+
+/* Header of a transaction in the log, followed by the images of
+   its CNT sectors.  Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Sequence number. */
+    uint32_t cnt;                       /* Number of sectors. */
+    uint32_t revoke_cnt;                /* Number of revoked sectors. */
+    unsigned checksum;                  /* Hash of the sector images. */
+    block_sector_t sectors[JOURNAL_HEADER_SECTORS];
+                                        /* Home locations of the images,
+                                           then the revoked sectors. */
+  };
+
+static struct lock journal_lock;        /* Protects all of the below. */
+static struct condition tx_done;        /* Signalled, when a transaction is committed. */
+static int handle_cnt;                  /* Number of open handles. */
+static bool commit_wanted;              /* Commit, when the handles are closed. */
+
+static block_sector_t tx_sectors[JOURNAL_TX_MAX];  /* Running transaction. */
+static size_t tx_cnt;
+static size_t tx_limit;                 /* Size, at which a transaction is committed
+                                           even with open handles. */
+static block_sector_t tx_revoked[JOURNAL_REVOKE_MAX];  /* Revoked by the running
+                                                          transaction. */
+static size_t revoked_cnt;
+
+static uint32_t next_seq;               /* Sequence number of the next transaction. */
+static block_sector_t head;             /* Log sector for the next transaction. */
+static block_sector_t logged[JOURNAL_LOG_SECTORS];  /* Sectors logged since the
+                                                       last checkpoint. */
+static size_t logged_cnt;
+static uint8_t *tx_buffer;              /* Header and images of a transaction. */
+
+/* Statistics. */
+static unsigned long long commit_cnt;
+static unsigned long long logged_sector_cnt;
+static unsigned long long checkpoint_cnt;
+static unsigned long long overflow_cnt;
+
+static void commit (void);
+static void checkpoint (void);
+static void revoke (block_sector_t);
+static bool in_transaction (block_sector_t);
+static void write_super (void);
+static size_t replay (void);
+static void commit_daemon (void *aux);
+
+/* Initializes the journal.  If FORMAT is true, starts an empty
+   log, otherwise replays the transactions, that were committed to
+   the log, but maybe not checkpointed, before the last shutdown. */
+void
+journal_init (bool format)
+{
+  ASSERT (sizeof (struct journal_super) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&tx_done);
+  tx_limit = cache_sector_count () / 4;
+  if (tx_limit > JOURNAL_TX_MAX)
+    tx_limit = JOURNAL_TX_MAX;
+  tx_buffer = malloc ((JOURNAL_TX_MAX + 1) * BLOCK_SECTOR_SIZE);
+  if (tx_buffer == NULL)
+    PANIC ("can't allocate the journal buffer");
+
+  if (format)
+    {
+      /* Nothing of an older log may look like a part of this one. */
+      memset (tx_buffer, 0, BLOCK_SECTOR_SIZE);
+      block_write (fs_device, LOG_START, tx_buffer);
+      next_seq = 1;
+    }
+  else
+    {
+      struct journal_super *super = (struct journal_super *) tx_buffer;
+      size_t cnt;
+
+      block_read (fs_device, JOURNAL_SECTOR, super);
+      if (super->magic != JOURNAL_MAGIC)
+        PANIC ("File system has no journal, reformat it with -f.");
+      next_seq = super->seq;
+      cnt = replay ();
+      if (cnt > 0)
+        printf ("Journal: replayed %zu transactions.\n", cnt);
+    }
+  head = LOG_START;
+  write_super ();
+
+  thread_create ("journal-commit", PRI_DEFAULT, commit_daemon, NULL);
+}
+
+/* Commits the running transaction and checkpoints the log, so that
+   the next start has nothing to replay. */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  commit ();
+  checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Opens a handle: the changes made until the matching
+   journal_end() are committed together.  Handles nest; only the
+   outermost one may be opened with file system locks held, as it
+   waits for a full transaction to be committed. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+  lock_acquire (&journal_lock);
+  while (commit_wanted || tx_cnt >= tx_limit / 2)
+    {
+      if (handle_cnt == 0)
+        {
+          commit ();
+          break;
+        }
+      cond_wait (&tx_done, &journal_lock);
+    }
+  handle_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Closes the handle, opened by journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  if (--handle_cnt == 0 && (commit_wanted || tx_cnt >= tx_limit / 2))
+    commit ();
+  lock_release (&journal_lock);
+}
+
+/* Adds SEC, a metadata sector the caller owns and is about to
+   change (or has just changed), to the running transaction. */
+void
+journal_add (struct sector *sec)
+{
+  size_t i;
+
+  lock_acquire (&journal_lock);
+
+  /* Reused as metadata: the new image is replayed after the old ones. */
+  for (i = 0; i < revoked_cnt; i++)
+    if (tx_revoked[i] == sec->index)
+      {
+        tx_revoked[i] = tx_revoked[--revoked_cnt];
+        break;
+      }
+
+  for (i = 0; i < tx_cnt; i++)
+    if (tx_sectors[i] == sec->index)
+      break;
+  if (i == tx_cnt)
+    {
+      if (tx_cnt == tx_limit)
+        {
+          /* Too big to be held back any longer. */
+          overflow_cnt++;
+          commit ();
+        }
+      cache_pin_sector (sec);
+      tx_sectors[tx_cnt++] = sec->index;
+    }
+  lock_release (&journal_lock);
+}
+
+/* Makes sure, that CNT more sectors fit in the running transaction,
+   so that changes, that must be atomic, are not split by an
+   overflow.  If they do not fit, the transaction is committed now,
+   like an overflowing one.  No more than the limit of a transaction,
+   at least 4 sectors, can be reserved. */
+void
+journal_reserve (size_t cnt)
+{
+  lock_acquire (&journal_lock);
+  if (cnt > tx_limit)
+    cnt = tx_limit;
+  if (tx_cnt > 0 && tx_cnt + cnt > tx_limit)
+    {
+      overflow_cnt++;
+      commit ();
+    }
+  lock_release (&journal_lock);
+}
+
+/* Revokes those of the CNT sectors from SECTOR, that have images in
+   the log or in the running transaction.  Called by the free map,
+   when it frees the sectors, before they can be allocated again. */
+void
+journal_revoke (block_sector_t sector, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < tx_cnt; i++)
+    if (tx_sectors[i] - sector < cnt)
+      revoke (tx_sectors[i]);
+  for (i = 0; i < logged_cnt; i++)
+    if (logged[i] - sector < cnt)
+      revoke (logged[i]);
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction, or, if there are open
+   handles, makes the last of them commit it. */
+void
+journal_commit (void)
+{
+  lock_acquire (&journal_lock);
+  if (handle_cnt == 0)
+    commit ();
+  else if (tx_cnt > 0)
+    commit_wanted = true;
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction and waits until it is on the
+   disk.  Must not be called with a handle open. */
+void
+journal_sync (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+  lock_acquire (&journal_lock);
+  if (tx_cnt > 0 || revoked_cnt > 0)
+    {
+      uint32_t seq = next_seq;
+      if (handle_cnt == 0)
+        commit ();
+      else
+        {
+          /* The last handle to close commits it. */
+          commit_wanted = true;
+          while (next_seq == seq)
+            cond_wait (&tx_done, &journal_lock);
+        }
+    }
+  lock_release (&journal_lock);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void)
+{
+  printf ("Journal: %llu commits, %llu sectors logged, %llu checkpoints, "
+          "%llu overflows\n",
+          commit_cnt, logged_sector_cnt, checkpoint_cnt, overflow_cnt);
+}
+
+/* Writes the running transaction to the log and unpins its
+   sectors.  Journal lock has to be held. */
+static void
+commit (void)
+{
+  struct journal_header *h = (struct journal_header *) tx_buffer;
+  size_t i;
+
+  if (tx_cnt > 0 || revoked_cnt > 0)
+    {
+      memset (h, 0, sizeof *h);
+      h->magic = JOURNAL_MAGIC;
+      h->seq = next_seq;
+      h->cnt = tx_cnt;
+      h->revoke_cnt = revoked_cnt;
+      for (i = 0; i < tx_cnt; i++)
+        {
+          h->sectors[i] = tx_sectors[i];
+          cache_copy_pinned (tx_sectors[i],
+                             tx_buffer + (i + 1) * BLOCK_SECTOR_SIZE);
+        }
+      memcpy (h->sectors + tx_cnt, tx_revoked,
+              revoked_cnt * sizeof *tx_revoked);
+      h->checksum = hash_bytes (tx_buffer + BLOCK_SECTOR_SIZE,
+                                tx_cnt * BLOCK_SECTOR_SIZE);
+      block_write_multiple (fs_device, head, tx_cnt + 1, tx_buffer);
+
+      for (i = 0; i < tx_cnt; i++)
+        {
+          cache_unpin_sector (tx_sectors[i]);
+          logged[logged_cnt++] = tx_sectors[i];
+        }
+      head += tx_cnt + 1;
+      next_seq++;
+      commit_cnt++;
+      logged_sector_cnt += tx_cnt;
+      tx_cnt = 0;
+      revoked_cnt = 0;
+
+      /* Make sure, that the next transaction fits. */
+      if (LOG_END - head < tx_limit + 1)
+        checkpoint ();
+    }
+  commit_wanted = false;
+  cond_broadcast (&tx_done, &journal_lock);
+}
+
+/* Writes the logged sectors back to their home locations and
+   restarts the log.  Journal lock has to be held. */
+static void
+checkpoint (void)
+{
+  if (head == LOG_START)
+    return;
+  cache_flush_sectors (logged, logged_cnt);
+  logged_cnt = 0;
+  head = LOG_START;
+  write_super ();
+  checkpoint_cnt++;
+}
+
+/* Adds SECTOR to the sectors revoked by the running transaction.
+   If there is no room for it, checkpoints the log first, which
+   leaves only the revokes of the sectors in the running transaction
+   needed.  Journal lock has to be held. */
+static void
+revoke (block_sector_t sector)
+{
+  size_t i, j;
+
+  for (i = 0; i < revoked_cnt; i++)
+    if (tx_revoked[i] == sector)
+      return;
+  if (revoked_cnt == JOURNAL_REVOKE_MAX)
+    {
+      checkpoint ();
+      for (i = j = 0; i < revoked_cnt; i++)
+        if (in_transaction (tx_revoked[i]))
+          tx_revoked[j++] = tx_revoked[i];
+      revoked_cnt = j;
+      if (!in_transaction (sector))
+        return;
+    }
+  tx_revoked[revoked_cnt++] = sector;
+}
+
+/* Returns true if SECTOR is in the running transaction.  Journal
+   lock has to be held. */
+static bool
+in_transaction (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < tx_cnt; i++)
+    if (tx_sectors[i] == sector)
+      return true;
+  return false;
+}
+
+/* Writes the superblock, which makes the log start with
+   transaction NEXT_SEQ at LOG_START. */
+static void
+write_super (void)
+{
+  struct journal_super *super = calloc (1, sizeof *super);
+  if (super == NULL)
+    PANIC ("can't allocate the journal superblock");
+  super->magic = JOURNAL_MAGIC;
+  super->seq = next_seq;
+  block_write (fs_device, JOURNAL_SECTOR, super);
+  free (super);
+}
+
+/* Returns true if the transaction at LOG, that is followed by the
+   ones at LOG + 1...LOG + CNT - 1, all in the log buffer BUF,
+   revokes SECTOR, or one of the later ones does. */
+static bool
+revoked (const uint8_t *buf, const block_sector_t *log, size_t cnt,
+         block_sector_t sector)
+{
+  size_t i, j;
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct journal_header *h
+        = (const struct journal_header *) (buf + log[i] * BLOCK_SECTOR_SIZE);
+      for (j = 0; j < h->revoke_cnt; j++)
+        if (h->sectors[h->cnt + j] == sector)
+          return true;
+    }
+  return false;
+}
+
+/* Copies the sector images of the complete transactions in the
+   log, starting with NEXT_SEQ, to their home locations, except
+   for the images of revoked sectors.  Returns the number of
+   transactions replayed. */
+static size_t
+replay (void)
+{
+  uint8_t *buf = malloc (JOURNAL_LOG_SECTORS * BLOCK_SECTOR_SIZE);
+  block_sector_t log[JOURNAL_LOG_SECTORS];  /* Offsets of the transactions. */
+  block_sector_t pos = 0;
+  size_t cnt = 0;
+  size_t i, j;
+
+  if (buf == NULL)
+    PANIC ("can't allocate the journal replay buffer");
+  block_read_multiple (fs_device, LOG_START, JOURNAL_LOG_SECTORS, buf);
+
+  /* Find the complete transactions first, so that the revokes of
+     the later ones are known, when the earlier ones are replayed. */
+  while (pos < JOURNAL_LOG_SECTORS)
+    {
+      const struct journal_header *h
+        = (const struct journal_header *) (buf + pos * BLOCK_SECTOR_SIZE);
+      if (h->magic != JOURNAL_MAGIC || h->seq != next_seq
+          || h->cnt + h->revoke_cnt == 0 || h->cnt > JOURNAL_TX_MAX
+          || h->revoke_cnt > JOURNAL_REVOKE_MAX
+          || pos + 1 + h->cnt > JOURNAL_LOG_SECTORS
+          || h->checksum != hash_bytes (buf + (pos + 1) * BLOCK_SECTOR_SIZE,
+                                        h->cnt * BLOCK_SECTOR_SIZE))
+        break;
+      log[cnt++] = pos;
+      pos += h->cnt + 1;
+      next_seq++;
+    }
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct journal_header *h
+        = (const struct journal_header *) (buf + log[i] * BLOCK_SECTOR_SIZE);
+      for (j = 0; j < h->cnt; j++)
+        {
+          struct sector *sec;
+
+          if (revoked (buf, log + i, cnt - i, h->sectors[j]))
+            continue;
+          sec = take_sector (h->sectors[j], true);
+          memcpy (sec->data, buf + (log[i] + 1 + j) * BLOCK_SECTOR_SIZE,
+                  BLOCK_SECTOR_SIZE);
+          release_sector (sec, h->sectors[j], true, true);
+        }
+    }
+  sector_cache_flush ();
+  free (buf);
+  return cnt;
+}
+
+/* Commits the running transaction every JOURNAL_COMMIT_TICKS. */
+static void
+commit_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_COMMIT_TICKS);
+      journal_commit ();
+    }
+}
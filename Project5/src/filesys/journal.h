@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+struct sector;
+
+/* Number of sectors in the log, that follows the journal superblock
+   at JOURNAL_SECTOR. */
+#define JOURNAL_LOG_SECTORS 64
+
+void journal_init (bool format);
+void journal_done (void);
+
+void journal_begin (void);
+void journal_end (void);
+void journal_add (struct sector *);
+void journal_reserve (size_t cnt);
+void journal_revoke (block_sector_t, size_t cnt);
+void journal_commit (void);
+void journal_sync (void);
+
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
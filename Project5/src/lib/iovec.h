@@ -0,0 +1,16 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* Most buffers in a readv() or writev() call. */
+#define IOV_MAX 64
+
+/* A buffer of a readv() or writev() call. */
+struct iovec
+  {
+    void *iov_base;             /* Start of the buffer. */
+    size_t iov_len;             /* Length of the buffer in bytes. */
+  };
+
+#endif /* lib/iovec.h */
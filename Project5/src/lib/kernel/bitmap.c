@@ -28,6 +28,7 @@ struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *summary; /* Optional; bit I is set iff element I is full. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -69,6 +70,82 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns the mask of the bits actually used in element IDX of B. */
+static inline elem_type
+elem_mask (const struct bitmap *b, size_t idx)
+{
+  return idx == elem_cnt (b->bit_cnt) - 1 ? last_mask (b) : (elem_type) -1;
+}
+
+/* Brings the summary bit of element IDX of B up to date, if B
+   has a summary. */
+static inline void
+summary_update (struct bitmap *b, size_t idx)
+{
+  if (b->summary != NULL)
+    {
+      elem_type mask = elem_mask (b, idx);
+      if ((b->bits[idx] & mask) == mask)
+        b->summary[elem_idx (idx)] |= bit_mask (idx);
+      else
+        b->summary[elem_idx (idx)] &= ~bit_mask (idx);
+    }
+}
+
+/* Returns the index of the first element of B at or after IDX,
+   but before END, that is not full, or END if there is none.
+   B must have a summary. */
+static size_t
+summary_next_nonfull (const struct bitmap *b, size_t idx, size_t end)
+{
+  size_t sidx = elem_idx (idx);
+  size_t last_sidx;
+  elem_type word;
+
+  if (idx >= end)
+    return end;
+  last_sidx = elem_idx (end - 1);
+  word = ~b->summary[sidx] & ((elem_type) -1 << (idx % ELEM_BITS));
+  while (word == 0)
+    {
+      if (++sidx > last_sidx)
+        return end;
+      word = ~b->summary[sidx];
+    }
+  idx = sidx * ELEM_BITS + __builtin_ctzl (word);
+  return idx < end ? idx : end;
+}
+
+/* Returns the index of the first bit of B at or after START, but
+   before END, that is set to VALUE, or END if there is none.
+   Whole elements are tested at a time, and searches for false
+   bits skip whole groups of full elements, if B has a summary. */
+static size_t
+find_next (const struct bitmap *b, size_t start, size_t end, bool value)
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t idx, last_idx, bit;
+  elem_type word;
+
+  if (start >= end)
+    return end;
+  idx = elem_idx (start);
+  last_idx = elem_idx (end - 1);
+  word = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+  while (word == 0)
+    {
+      if (!value && b->summary != NULL)
+        idx = summary_next_nonfull (b, idx + 1, last_idx + 1);
+      else
+        idx++;
+      if (idx > last_idx)
+        return end;
+      word = b->bits[idx] ^ flip;
+    }
+  bit = idx * ELEM_BITS + __builtin_ctzl (word);
+  return bit < end ? bit : end;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -83,6 +160,7 @@ bitmap_create (size_t bit_cnt)
     {
       b->bit_cnt = bit_cnt;
       b->bits = malloc (byte_cnt (bit_cnt));
+      b->summary = NULL;
       if (b->bits != NULL || bit_cnt == 0)
         {
           bitmap_set_all (b, false);
@@ -105,6 +183,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->summary = NULL;
   bitmap_set_all (b, false);
   return b;
 }
@@ -124,11 +203,35 @@ bitmap_destroy (struct bitmap *b)
 {
   if (b != NULL) 
     {
+      free (b->summary);
       free (b->bits);
       free (b);
     }
 }
 
+/* Gives B a summary with one bit per element, that tells whether
+   the element is full, so that bitmap_scan() for false bits skips
+   the full parts of a nearly full bitmap quickly.  The summary
+   takes 1/32 of the memory of B.  Updates of the summary are not
+   atomic, so a B with a summary must be protected by a lock.  Not
+   for use on bitmaps created by bitmap_create_in_buf().  Returns false if memory allocation
+   fails; B still works then, only without the summary. */
+bool
+bitmap_enable_summary (struct bitmap *b) 
+{
+  size_t i;
+
+  ASSERT (b != NULL);
+  if (b->summary != NULL || b->bit_cnt == 0)
+    return true;
+  b->summary = calloc (elem_cnt (elem_cnt (b->bit_cnt)), sizeof (elem_type));
+  if (b->summary == NULL)
+    return false;
+  for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+    summary_update (b, i);
+  return true;
+}
+
 /* Bitmap size. */
 
 /* Returns the number of bits in B. */
@@ -163,6 +266,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  summary_update (b, idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -176,6 +280,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  summary_update (b, idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,6 +296,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  summary_update (b, idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -250,16 +356,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_next (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -291,20 +392,33 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+   Jumps from each run of VALUE bits to the end of it, so every
+   element of B is looked at no more than twice. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 0)
+    return start;
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+      while (i <= last)
+        {
+          size_t end;
+
+          i = find_next (b, i, last + 1, value);
+          if (i > last)
+            break;
+          end = find_next (b, i, i + cnt, !value);
+          if (end == i + cnt)
+            return i;
+          i = end + 1;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -346,6 +460,12 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      if (b->summary != NULL)
+        {
+          size_t i;
+          for (i = 0; i < elem_cnt (b->bit_cnt); i++)
+            summary_update (b, i);
+        }
     }
   return success;
 }
@@ -358,6 +478,25 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the elements of B, that hold bits START...START + CNT - 1,
+   to their place in FILE (as written by bitmap_write()).  Return
+   true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+  if (cnt == 0)
+    return true;
+
+  size_t first = elem_idx (start);
+  size_t last = elem_idx (start + cnt - 1);
+  off_t size = (last - first + 1) * sizeof (elem_type);
+  return file_write_at (file, b->bits + first, size,
+                        first * sizeof (elem_type)) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
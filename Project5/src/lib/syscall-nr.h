@@ -28,7 +28,15 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_OPENAT,                 /* Open a file relative to a directory fd. */
+    SYS_MKDIRAT,                /* Create a directory relative to a dir fd. */
+    SYS_REMOVEAT,               /* Delete a file relative to a directory fd. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write several buffers to a file. */
+    SYS_FSYNC                   /* Write a file's cached sectors to disk. */
   };
 
 #endif /* lib/syscall-nr.h */
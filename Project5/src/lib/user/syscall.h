@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <stddef.h>
+#include <iovec.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -33,6 +35,10 @@ int write (int fd, const void *buffer, unsigned length);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *iov, int iov_cnt);
+int writev (int fd, const struct iovec *iov, int iov_cnt);
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
@@ -44,5 +50,9 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
+int openat (int dir_fd, const char *file);
+bool mkdirat (int dir_fd, const char *dir);
+bool removeat (int dir_fd, const char *file);
+int fsync (int fd);
 
 #endif /* lib/user/syscall.h */
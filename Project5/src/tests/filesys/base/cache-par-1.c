@@ -0,0 +1,5 @@
+/* Measures cache hit throughput with 1 hot reader(s).
+   See cache-par.inc for details. */
+
+#define READER_CNT 1
+#include "tests/filesys/base/cache-par.inc"
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-par-1) begin
+(cache-par-1) create "hot"
+(cache-par-1) open "hot"
+(cache-par-1) write "hot"
+(cache-par-1) close "hot"
+(cache-par-1) create "cold"
+(cache-par-1) open "cold"
+(cache-par-1) write "cold"
+(cache-par-1) close "cold"
+(cache-par-1) exec child 1 of 2: "child-cache-par 0 1"
+(cache-par-1) exec child 2 of 2: "child-cache-par 1 1"
+(cache-par-1) wait for child 1 of 2 returned 0 (expected 0)
+(cache-par-1) wait for child 2 of 2 returned 1 (expected 1)
+(cache-par-1) end
+EOF
+my ($ticks) = map (/Timer: (\d+) ticks/, read_text_file ("$test.output"));
+pass "1 hot reader(s): $ticks timer ticks";
@@ -0,0 +1,5 @@
+/* Measures cache hit throughput with 4 hot reader(s).
+   See cache-par.inc for details. */
+
+#define READER_CNT 4
+#include "tests/filesys/base/cache-par.inc"
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-par-4) begin
+(cache-par-4) create "hot"
+(cache-par-4) open "hot"
+(cache-par-4) write "hot"
+(cache-par-4) close "hot"
+(cache-par-4) create "cold"
+(cache-par-4) open "cold"
+(cache-par-4) write "cold"
+(cache-par-4) close "cold"
+(cache-par-4) exec child 1 of 5: "child-cache-par 0 4"
+(cache-par-4) exec child 2 of 5: "child-cache-par 1 4"
+(cache-par-4) exec child 3 of 5: "child-cache-par 2 4"
+(cache-par-4) exec child 4 of 5: "child-cache-par 3 4"
+(cache-par-4) exec child 5 of 5: "child-cache-par 4 4"
+(cache-par-4) wait for child 1 of 5 returned 0 (expected 0)
+(cache-par-4) wait for child 2 of 5 returned 1 (expected 1)
+(cache-par-4) wait for child 3 of 5 returned 2 (expected 2)
+(cache-par-4) wait for child 4 of 5 returned 3 (expected 3)
+(cache-par-4) wait for child 5 of 5 returned 4 (expected 4)
+(cache-par-4) end
+EOF
+my ($ticks) = map (/Timer: (\d+) ticks/, read_text_file ("$test.output"));
+pass "4 hot reader(s): $ticks timer ticks";
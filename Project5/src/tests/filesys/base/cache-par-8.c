@@ -0,0 +1,5 @@
+/* Measures cache hit throughput with 8 hot reader(s).
+   See cache-par.inc for details. */
+
+#define READER_CNT 8
+#include "tests/filesys/base/cache-par.inc"
@@ -0,0 +1,37 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-par-8) begin
+(cache-par-8) create "hot"
+(cache-par-8) open "hot"
+(cache-par-8) write "hot"
+(cache-par-8) close "hot"
+(cache-par-8) create "cold"
+(cache-par-8) open "cold"
+(cache-par-8) write "cold"
+(cache-par-8) close "cold"
+(cache-par-8) exec child 1 of 9: "child-cache-par 0 8"
+(cache-par-8) exec child 2 of 9: "child-cache-par 1 8"
+(cache-par-8) exec child 3 of 9: "child-cache-par 2 8"
+(cache-par-8) exec child 4 of 9: "child-cache-par 3 8"
+(cache-par-8) exec child 5 of 9: "child-cache-par 4 8"
+(cache-par-8) exec child 6 of 9: "child-cache-par 5 8"
+(cache-par-8) exec child 7 of 9: "child-cache-par 6 8"
+(cache-par-8) exec child 8 of 9: "child-cache-par 7 8"
+(cache-par-8) exec child 9 of 9: "child-cache-par 8 8"
+(cache-par-8) wait for child 1 of 9 returned 0 (expected 0)
+(cache-par-8) wait for child 2 of 9 returned 1 (expected 1)
+(cache-par-8) wait for child 3 of 9 returned 2 (expected 2)
+(cache-par-8) wait for child 4 of 9 returned 3 (expected 3)
+(cache-par-8) wait for child 5 of 9 returned 4 (expected 4)
+(cache-par-8) wait for child 6 of 9 returned 5 (expected 5)
+(cache-par-8) wait for child 7 of 9 returned 6 (expected 6)
+(cache-par-8) wait for child 8 of 9 returned 7 (expected 7)
+(cache-par-8) wait for child 9 of 9 returned 8 (expected 8)
+(cache-par-8) end
+EOF
+my ($ticks) = map (/Timer: (\d+) ticks/, read_text_file ("$test.output"));
+pass "8 hot reader(s): $ticks timer ticks";
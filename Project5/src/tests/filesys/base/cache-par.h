@@ -0,0 +1,11 @@
+#ifndef TESTS_FILESYS_BASE_CACHE_PAR_H
+#define TESTS_FILESYS_BASE_CACHE_PAR_H
+
+#define CHUNK_SIZE 512
+#define HOT_SIZE (4 * CHUNK_SIZE)     /* Always stays in the buffer cache. */
+#define COLD_SIZE (128 * CHUNK_SIZE)  /* Twice the size of the buffer cache. */
+#define HOT_READS 2048                /* Hot chunk reads, split among the readers. */
+static const char hot_file_name[] = "hot";
+static const char cold_file_name[] = "cold";
+
+#endif /* tests/filesys/base/cache-par.h */
@@ -0,0 +1,62 @@
+/* Child process for cache-par tests.
+   Child 0 streams once through the cold file, every other child
+   reads its share of HOT_READS chunks from the hot file. */
+
+#include <random.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/cache-par.h"
+
+const char *test_name = "child-cache-par";
+
+static char hot_buf[HOT_SIZE];
+static char cold_buf[COLD_SIZE];
+
+int
+main (int argc, char *argv[]) 
+{
+  char chunk[CHUNK_SIZE];
+  int child_idx, reader_cnt;
+  int fd;
+  size_t ofs;
+  int i;
+
+  quiet = true;
+
+  CHECK (argc == 3, "argc must be 3, actually %d", argc);
+  child_idx = atoi (argv[1]);
+  reader_cnt = atoi (argv[2]);
+
+  random_init (0);
+  random_bytes (hot_buf, sizeof hot_buf);
+  random_bytes (cold_buf, sizeof cold_buf);
+
+  if (child_idx == 0) 
+    {
+      CHECK ((fd = open (cold_file_name)) > 1, "open \"%s\"", cold_file_name);
+      for (ofs = 0; ofs < sizeof cold_buf; ofs += CHUNK_SIZE) 
+        {
+          CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\"", cold_file_name);
+          compare_bytes (chunk, cold_buf + ofs, CHUNK_SIZE, ofs,
+                         cold_file_name);
+        }
+    }
+  else 
+    {
+      CHECK ((fd = open (hot_file_name)) > 1, "open \"%s\"", hot_file_name);
+      for (i = 0; i < HOT_READS / reader_cnt; i++) 
+        {
+          ofs = (i * CHUNK_SIZE) % sizeof hot_buf;
+          seek (fd, ofs);
+          CHECK (read (fd, chunk, CHUNK_SIZE) == CHUNK_SIZE,
+                 "read \"%s\"", hot_file_name);
+          compare_bytes (chunk, hot_buf + ofs, CHUNK_SIZE, ofs,
+                         hot_file_name);
+        }
+    }
+  close (fd);
+
+  return child_idx;
+}
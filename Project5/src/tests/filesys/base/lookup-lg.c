@@ -0,0 +1,5 @@
+/* Counts block map lookups for a large file.
+   See lookup.inc for details. */
+
+#define TEST_SIZE 262144
+#include "tests/filesys/base/lookup.inc"
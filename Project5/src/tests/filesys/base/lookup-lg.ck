@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lookup-lg) begin
+(lookup-lg) create "lookup"
+(lookup-lg) open "lookup"
+(lookup-lg) writing "lookup"
+(lookup-lg) close "lookup"
+(lookup-lg) open "lookup" for verification
+(lookup-lg) verified contents of "lookup"
+(lookup-lg) close "lookup"
+(lookup-lg) end
+EOF
+my ($lookups, $index_reads, $bytes)
+  = map (/Inode: (\d+) lookups, (\d+) index sector reads, (\d+) bytes read/,
+	 read_text_file ("$test.output"));
+pass sprintf ("262144-byte file: %.4f lookups, %.4f index sector reads per byte read",
+	      $lookups / $bytes, $index_reads / $bytes);
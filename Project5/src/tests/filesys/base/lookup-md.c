@@ -0,0 +1,5 @@
+/* Counts block map lookups for a medium file.
+   See lookup.inc for details. */
+
+#define TEST_SIZE 61440
+#include "tests/filesys/base/lookup.inc"
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lookup-md) begin
+(lookup-md) create "lookup"
+(lookup-md) open "lookup"
+(lookup-md) writing "lookup"
+(lookup-md) close "lookup"
+(lookup-md) open "lookup" for verification
+(lookup-md) verified contents of "lookup"
+(lookup-md) close "lookup"
+(lookup-md) end
+EOF
+my ($lookups, $index_reads, $bytes)
+  = map (/Inode: (\d+) lookups, (\d+) index sector reads, (\d+) bytes read/,
+	 read_text_file ("$test.output"));
+pass sprintf ("61440-byte file: %.4f lookups, %.4f index sector reads per byte read",
+	      $lookups / $bytes, $index_reads / $bytes);
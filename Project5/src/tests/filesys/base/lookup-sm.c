@@ -0,0 +1,5 @@
+/* Counts block map lookups for a small file.
+   See lookup.inc for details. */
+
+#define TEST_SIZE 4096
+#include "tests/filesys/base/lookup.inc"
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lookup-sm) begin
+(lookup-sm) create "lookup"
+(lookup-sm) open "lookup"
+(lookup-sm) writing "lookup"
+(lookup-sm) close "lookup"
+(lookup-sm) open "lookup" for verification
+(lookup-sm) verified contents of "lookup"
+(lookup-sm) close "lookup"
+(lookup-sm) end
+EOF
+my ($lookups, $index_reads, $bytes)
+  = map (/Inode: (\d+) lookups, (\d+) index sector reads, (\d+) bytes read/,
+	 read_text_file ("$test.output"));
+pass sprintf ("4096-byte file: %.4f lookups, %.4f index sector reads per byte read",
+	      $lookups / $bytes, $index_reads / $bytes);
@@ -0,0 +1,91 @@
+/* Child process for syn-append.
+
+   Children 0...READER_CNT - 1 read the whole file over and over,
+   until they find it complete.  Every chunk they read must either
+   still be zeros or hold its final contents.
+
+   The other children are appenders.  Appender I writes chunks I,
+   I + APPENDER_CNT, I + 2 * APPENDER_CNT, ..., so that the
+   appenders extend the file in turns and fill each other's
+   holes. */
+
+#include <random.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/filesys/extended/syn-append.h"
+#include "tests/lib.h"
+
+const char *test_name = "child-syn-append";
+
+static char expected[BUF_SIZE];
+static char actual[BUF_SIZE];
+static const char zeros[CHUNK_SIZE];
+
+/* Reads the file until it is complete. */
+static void
+read_file (int fd)
+{
+  for (;;)
+    {
+      size_t ofs, written = 0;
+      int bytes_read;
+
+      seek (fd, 0);
+      bytes_read = read (fd, actual, sizeof actual);
+      CHECK (bytes_read >= 0 && bytes_read <= BUF_SIZE
+             && bytes_read % CHUNK_SIZE == 0,
+             "read of \"%s\" returned invalid value of %d",
+             file_name, bytes_read);
+      for (ofs = 0; ofs < (size_t) bytes_read; ofs += CHUNK_SIZE)
+        if (memcmp (actual + ofs, zeros, CHUNK_SIZE))
+          {
+            compare_bytes (actual + ofs, expected + ofs, CHUNK_SIZE, ofs,
+                           file_name);
+            written++;
+          }
+      if (written == BUF_SIZE / CHUNK_SIZE)
+        return;
+    }
+}
+
+/* Writes the chunks of appender APPENDER_IDX. */
+static void
+append_file (int fd, int appender_idx)
+{
+  size_t chunk;
+
+  for (chunk = appender_idx; chunk < BUF_SIZE / CHUNK_SIZE;
+       chunk += APPENDER_CNT)
+    {
+      size_t ofs = chunk * CHUNK_SIZE;
+      seek (fd, ofs);
+      CHECK (write (fd, expected + ofs, CHUNK_SIZE) == CHUNK_SIZE,
+             "write %d bytes at offset %zu in \"%s\"",
+             CHUNK_SIZE, ofs, file_name);
+    }
+}
+
+int
+main (int argc, const char *argv[]) 
+{
+  int child_idx;
+  int fd;
+
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (0);
+  random_bytes (expected, sizeof expected);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  if (child_idx < READER_CNT)
+    read_file (fd);
+  else
+    append_file (fd, child_idx - READER_CNT);
+  close (fd);
+
+  return child_idx;
+}
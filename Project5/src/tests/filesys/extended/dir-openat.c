@@ -0,0 +1,29 @@
+/* Creates, opens and removes files and directories relative to
+   directory file descriptors with openat(), mkdirat() and
+   removeat(). */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int a_fd, b_fd;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK ((a_fd = open ("a")) > 1, "open \"a\"");
+  CHECK (mkdirat (a_fd, "b"), "mkdirat \"b\"");
+  CHECK (create ("a/b/c", 512), "create \"a/b/c\"");
+  CHECK ((b_fd = openat (a_fd, "b")) > 1, "openat \"b\"");
+  CHECK (isdir (b_fd), "isdir \"b\"");
+  CHECK (openat (b_fd, "c") > 1, "openat \"c\"");
+  CHECK (!removeat (a_fd, "b"), "removeat \"b\" (must return false)");
+  CHECK (removeat (b_fd, "c"), "removeat \"c\"");
+  CHECK (openat (b_fd, "c") == -1, "openat \"c\" (must return -1)");
+  close (b_fd);
+  CHECK (removeat (a_fd, "b"), "removeat \"b\"");
+  CHECK (mkdirat (a_fd, "d"), "mkdirat \"d\"");
+  CHECK (openat (0, "d") == -1, "openat \"d\" in fd 0 (must return -1)");
+  close (a_fd);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-openat) begin
+(dir-openat) mkdir "a"
+(dir-openat) open "a"
+(dir-openat) mkdirat "b"
+(dir-openat) create "a/b/c"
+(dir-openat) openat "b"
+(dir-openat) isdir "b"
+(dir-openat) openat "c"
+(dir-openat) removeat "b" (must return false)
+(dir-openat) removeat "c"
+(dir-openat) openat "c" (must return -1)
+(dir-openat) removeat "b"
+(dir-openat) mkdirat "d"
+(dir-openat) openat "d" in fd 0 (must return -1)
+(dir-openat) end
+EOF
+pass;
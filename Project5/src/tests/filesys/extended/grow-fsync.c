@@ -0,0 +1,34 @@
+/* Grows a file from 0 bytes to 5,678 bytes, 1,234 bytes at a
+   time, writing its cached sectors to disk with fsync() after
+   each write.  fsync() of a file descriptor that is not open must
+   fail.  The kernel is run with -crash, so the file only survives
+   into the persistence check, if fsync() committed its growth. */
+
+#include <syscall.h>
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[5678];
+
+static size_t
+return_block_size (void) 
+{
+  return 1234;
+}
+
+static void
+check_fsync (int fd, long ofs) 
+{
+  if (fsync (fd) != 0)
+    fail ("fsync failed after writing %ld bytes", ofs);
+}
+
+void
+test_main (void) 
+{
+  seq_test ("testme",
+            buf, sizeof buf, 0,
+            return_block_size, check_fsync);
+  CHECK (fsync (5678) == -1, "fsync of a file that is not open (must return -1)");
+}
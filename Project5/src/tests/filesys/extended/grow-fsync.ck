@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-fsync) begin
+(grow-fsync) create "testme"
+(grow-fsync) open "testme"
+(grow-fsync) writing "testme"
+(grow-fsync) close "testme"
+(grow-fsync) open "testme" for verification
+(grow-fsync) verified contents of "testme"
+(grow-fsync) close "testme"
+(grow-fsync) fsync of a file that is not open (must return -1)
+(grow-fsync) end
+EOF
+pass;
@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"testfile" => ["\0" x 30000 . "a" x 5000 . "\0" x 55000 . "b"]});
+pass;
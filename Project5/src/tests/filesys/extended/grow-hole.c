@@ -0,0 +1,32 @@
+/* Tests that writing into the holes of a file, created with an
+   initial size and grown by a seek past its end, keeps the rest
+   of the holes reading as zeros. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[90001];
+
+void
+test_main (void) 
+{
+  const char *file_name = "testfile";
+  int fd;
+
+  memset (buf + 30000, 'a', 5000);
+  buf[sizeof buf - 1] = 'b';
+
+  CHECK (create (file_name, 60000), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("seek \"%s\" to 30000", file_name);
+  seek (fd, 30000);
+  CHECK (write (fd, buf + 30000, 5000) == 5000, "write \"%s\"", file_name);
+  msg ("seek \"%s\" to %zu", file_name, sizeof buf - 1);
+  seek (fd, sizeof buf - 1);
+  CHECK (write (fd, buf + sizeof buf - 1, 1) == 1, "write \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+  check_file (file_name, buf, sizeof buf);
+}
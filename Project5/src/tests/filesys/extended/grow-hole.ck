@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(grow-hole) begin
+(grow-hole) create "testfile"
+(grow-hole) open "testfile"
+(grow-hole) seek "testfile" to 30000
+(grow-hole) write "testfile"
+(grow-hole) seek "testfile" to 90000
+(grow-hole) write "testfile"
+(grow-hole) close "testfile"
+(grow-hole) open "testfile" for verification
+(grow-hole) verified contents of "testfile"
+(grow-hole) close "testfile"
+(grow-hole) end
+EOF
+pass;
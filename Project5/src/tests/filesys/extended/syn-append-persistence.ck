@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::random;
+check_archive ({"child-syn-append" => "tests/filesys/extended/child-syn-append",
+		"logfile" => [random_bytes (64 * 128 * 4)]});
+pass;
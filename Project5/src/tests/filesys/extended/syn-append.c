@@ -0,0 +1,17 @@
+/* Grows a file from several appending subprocesses at once, while
+   other subprocesses read it.  See child-syn-append.c. */
+
+#include <syscall.h>
+#include "tests/filesys/extended/syn-append.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  pid_t children[READER_CNT + APPENDER_CNT];
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  exec_children ("child-syn-append", children, READER_CNT + APPENDER_CNT);
+  wait_children (children, READER_CNT + APPENDER_CNT);
+}
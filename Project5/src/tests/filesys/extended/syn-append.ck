@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(syn-append) begin
+(syn-append) create "logfile"
+(syn-append) exec child 1 of 8: "child-syn-append 0"
+(syn-append) exec child 2 of 8: "child-syn-append 1"
+(syn-append) exec child 3 of 8: "child-syn-append 2"
+(syn-append) exec child 4 of 8: "child-syn-append 3"
+(syn-append) exec child 5 of 8: "child-syn-append 4"
+(syn-append) exec child 6 of 8: "child-syn-append 5"
+(syn-append) exec child 7 of 8: "child-syn-append 6"
+(syn-append) exec child 8 of 8: "child-syn-append 7"
+(syn-append) wait for child 1 of 8 returned 0 (expected 0)
+(syn-append) wait for child 2 of 8 returned 1 (expected 1)
+(syn-append) wait for child 3 of 8 returned 2 (expected 2)
+(syn-append) wait for child 4 of 8 returned 3 (expected 3)
+(syn-append) wait for child 5 of 8 returned 4 (expected 4)
+(syn-append) wait for child 6 of 8 returned 5 (expected 5)
+(syn-append) wait for child 7 of 8 returned 6 (expected 6)
+(syn-append) wait for child 8 of 8 returned 7 (expected 7)
+(syn-append) end
+EOF
+my ($ticks) = map (/Timer: (\d+) ticks/, read_text_file ("$test.output"));
+pass "4 appenders and 4 readers: 32768 bytes appended in $ticks timer ticks";
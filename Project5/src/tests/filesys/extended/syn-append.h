@@ -0,0 +1,11 @@
+#ifndef TESTS_FILESYS_EXTENDED_SYN_APPEND_H
+#define TESTS_FILESYS_EXTENDED_SYN_APPEND_H
+
+#define READER_CNT 4
+#define APPENDER_CNT 4
+#define CHUNK_SIZE 64
+#define CHUNK_CNT 128           /* Chunks per appender. */
+#define BUF_SIZE (CHUNK_SIZE * CHUNK_CNT * APPENDER_CNT)
+static const char file_name[] = "logfile";
+
+#endif /* tests/filesys/extended/syn-append.h */
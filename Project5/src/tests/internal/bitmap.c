@@ -0,0 +1,132 @@
+/* Test program and microbenchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan() against the simple bit-by-bit scan it
+   replaced, on bitmaps filled to various levels, with and
+   without a summary, and prints the timer ticks each of them
+   takes.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+#include "devices/timer.h"
+
+/* Number of bits in the tested bitmaps (a 16 MB disk). */
+#define BIT_CNT 32768
+
+/* Number of scans timed per fill level and group size. */
+#define SCAN_CNT 64
+
+static size_t old_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool value);
+static void fill (struct bitmap *, int percent);
+static int64_t time_scans (const struct bitmap *, size_t cnt, bool old);
+
+/* Test the bitmap scan. */
+void
+test (void)
+{
+  static const int fill_levels[] = {0, 50, 90, 99, 100};
+  static const size_t group_sizes[] = {1, 8, 64};
+  struct bitmap *plain = bitmap_create (BIT_CNT);
+  struct bitmap *summed = bitmap_create (BIT_CNT);
+  size_t i, j;
+
+  ASSERT (plain != NULL && summed != NULL);
+  ASSERT (bitmap_enable_summary (summed));
+
+  printf ("fill  cnt   old ticks  new ticks  summary ticks\n");
+  for (i = 0; i < sizeof fill_levels / sizeof *fill_levels; i++)
+    {
+      random_init (fill_levels[i]);
+      fill (plain, fill_levels[i]);
+      random_init (fill_levels[i]);
+      fill (summed, fill_levels[i]);
+
+      for (j = 0; j < sizeof group_sizes / sizeof *group_sizes; j++)
+        {
+          size_t cnt = group_sizes[j];
+          size_t start;
+
+          /* Verify against the old scan from a number of starts. */
+          for (start = 0; start < BIT_CNT; start += 997)
+            {
+              size_t expected = old_scan (plain, start, cnt, false);
+              ASSERT (bitmap_scan (plain, start, cnt, false) == expected);
+              ASSERT (bitmap_scan (summed, start, cnt, false) == expected);
+              ASSERT (bitmap_scan (plain, start, cnt, true)
+                      == old_scan (plain, start, cnt, true));
+            }
+
+          printf ("%3d%%  %3zu  %10lld %10lld %14lld\n",
+                  fill_levels[i], cnt,
+                  time_scans (plain, cnt, true),
+                  time_scans (plain, cnt, false),
+                  time_scans (summed, cnt, false));
+        }
+    }
+
+  bitmap_destroy (plain);
+  bitmap_destroy (summed);
+  printf ("bitmap: PASS\n");
+}
+
+/* The bit-by-bit scan, that bitmap_scan() used before. */
+static size_t
+old_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  if (cnt <= bitmap_size (b))
+    {
+      size_t last = bitmap_size (b) - cnt;
+      size_t i, j;
+      for (i = start; i <= last; i++)
+        {
+          for (j = 0; j < cnt; j++)
+            if (bitmap_test (b, i + j) != value)
+              break;
+          if (j == cnt)
+            return i;
+        }
+    }
+  return BITMAP_ERROR;
+}
+
+/* Sets about PERCENT percent of the bits of B, at random, except
+   for 100 percent, which leaves a single free bit at the end. */
+static void
+fill (struct bitmap *b, int percent)
+{
+  size_t i;
+
+  bitmap_set_all (b, false);
+  for (i = 0; i < bitmap_size (b); i++)
+    if ((int) (random_ulong () % 100) < percent)
+      bitmap_mark (b, i);
+  if (percent == 100)
+    bitmap_reset (b, bitmap_size (b) - 1);
+}
+
+/* Returns the timer ticks SCAN_CNT scans for CNT false bits in B
+   take, with the old scan if OLD is true. */
+static int64_t
+time_scans (const struct bitmap *b, size_t cnt, bool old)
+{
+  int64_t start = timer_ticks ();
+  int i;
+
+  for (i = 0; i < SCAN_CNT; i++)
+    {
+      size_t ofs = (size_t) i * (BIT_CNT / SCAN_CNT);
+      if (old)
+        old_scan (b, ofs, cnt, false);
+      else
+        bitmap_scan (b, ofs, cnt, false);
+    }
+  return timer_elapsed (start);
+}
@@ -177,6 +177,12 @@ sub compare_output {
 			&& !/^ esi=.* edi=.* esp=.* ebp=.*/
 			&& !/^ cs=.* ds=.* es=.* ss=.*/, @output);
     }
+    my $ignore_vm_stats = exists $options{IGNORE_VM_STATS};
+    if ($ignore_vm_stats) {
+	delete $options{IGNORE_VM_STATS};
+	@output = grep (!/^[\w-]+: \d+ page faults in \d+ ticks, /,
+			@output);
+    }
     die "unknown option " . (keys (%options))[0] . "\n" if %options;
 
     my ($msg);
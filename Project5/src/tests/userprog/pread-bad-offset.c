@@ -0,0 +1,38 @@
+/* Passes pread() and pwrite() offsets, that do not fit in a file
+   offset, or ranges, that run past its largest value.  Both must
+   fail with -1 and leave the file alone. */
+
+#include <limits.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+  int handle;
+
+  CHECK (create ("test.txt", sizeof sample - 1), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (write (handle, sample, sizeof sample - 1) == (int) (sizeof sample - 1),
+         "write \"test.txt\"");
+
+  CHECK (pread (handle, buf, sizeof buf, 0x80000000u) == -1,
+         "pread at offset 0x80000000 (must return -1)");
+  CHECK (pread (handle, buf, sizeof buf, UINT_MAX - 3) == -1,
+         "pread at offset 0xfffffffc (must return -1)");
+  CHECK (pread (handle, buf, sizeof buf, INT_MAX - 3) == -1,
+         "pread across the largest offset (must return -1)");
+  CHECK (pwrite (handle, buf, sizeof buf, 0x80000000u) == -1,
+         "pwrite at offset 0x80000000 (must return -1)");
+  CHECK (pwrite (handle, buf, sizeof buf, UINT_MAX - 3) == -1,
+         "pwrite at offset 0xfffffffc (must return -1)");
+  CHECK (pwrite (handle, buf, sizeof buf, INT_MAX - 3) == -1,
+         "pwrite across the largest offset (must return -1)");
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
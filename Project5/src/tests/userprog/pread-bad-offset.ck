@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-bad-offset) begin
+(pread-bad-offset) create "test.txt"
+(pread-bad-offset) open "test.txt"
+(pread-bad-offset) write "test.txt"
+(pread-bad-offset) pread at offset 0x80000000 (must return -1)
+(pread-bad-offset) pread at offset 0xfffffffc (must return -1)
+(pread-bad-offset) pread across the largest offset (must return -1)
+(pread-bad-offset) pwrite at offset 0x80000000 (must return -1)
+(pread-bad-offset) pwrite at offset 0xfffffffc (must return -1)
+(pread-bad-offset) pwrite across the largest offset (must return -1)
+(pread-bad-offset) close "test.txt"
+(pread-bad-offset) open "test.txt" for verification
+(pread-bad-offset) verified contents of "test.txt"
+(pread-bad-offset) close "test.txt"
+(pread-bad-offset) end
+pread-bad-offset: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Writes a file with pwrite() and reads it back with pread(), at
+   explicit offsets, which must leave the file position alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  const size_t half = (sizeof sample - 1) / 2;
+  char buf[sizeof sample];
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (pwrite (handle, sample + half, sizeof sample - 1 - half, half)
+         == (int) (sizeof sample - 1 - half), "pwrite second half");
+  CHECK (pwrite (handle, sample, half, 0) == (int) half, "pwrite first half");
+  CHECK (tell (handle) == 0, "tell \"test.txt\" (must return 0)");
+
+  CHECK (pread (handle, buf, 20, 100) == 20, "pread 20 bytes at offset 100");
+  if (memcmp (buf, sample + 100, 20))
+    fail ("pread returned wrong data");
+  CHECK (pread (handle, buf, sizeof buf, sizeof sample - 11) == 10,
+         "pread past end of file");
+  CHECK (tell (handle) == 0, "tell \"test.txt\" (must return 0)");
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", sample, sizeof sample - 1);
+}
@@ -0,0 +1,49 @@
+/* Writes three copies of the sample with one writev(), so that
+   a sector boundary falls inside one of the buffers, and reads
+   them back with one readv() into differently split buffers. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SAMPLE_LEN (sizeof sample - 1)
+
+static char expected[3 * SAMPLE_LEN];
+static char buf[3 * SAMPLE_LEN];
+
+void
+test_main (void) 
+{
+  struct iovec out[3], in[4];
+  int handle, i;
+
+  for (i = 0; i < 3; i++)
+    {
+      out[i].iov_base = sample;
+      out[i].iov_len = SAMPLE_LEN;
+      memcpy (expected + i * SAMPLE_LEN, sample, SAMPLE_LEN);
+    }
+  in[0].iov_base = buf;
+  in[0].iov_len = 100;
+  in[1].iov_base = buf + 100;
+  in[1].iov_len = 0;
+  in[2].iov_base = buf + 100;
+  in[2].iov_len = 500;
+  in[3].iov_base = buf + 600;
+  in[3].iov_len = sizeof buf - 600;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (writev (handle, out, 3) == (int) sizeof expected, "writev 3 buffers");
+  CHECK (tell (handle) == sizeof expected, "tell \"test.txt\"");
+  seek (handle, 0);
+  CHECK (readv (handle, in, 4) == (int) sizeof buf, "readv 4 buffers");
+  compare_bytes (buf, expected, sizeof buf, 0, "test.txt");
+  CHECK (readv (handle, in, -1) == -1, "readv -1 buffers (must return -1)");
+  msg ("close \"test.txt\"");
+  close (handle);
+
+  check_file ("test.txt", expected, sizeof expected);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "test.txt"
+(readv-writev) open "test.txt"
+(readv-writev) writev 3 buffers
+(readv-writev) tell "test.txt"
+(readv-writev) readv 4 buffers
+(readv-writev) readv -1 buffers (must return -1)
+(readv-writev) close "test.txt"
+(readv-writev) open "test.txt" for verification
+(readv-writev) verified contents of "test.txt"
+(readv-writev) close "test.txt"
+(readv-writev) end
+readv-writev: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@stats) = grep (/^child-linear: \d+ page faults in \d+ ticks/,
+		    read_text_file ("$test.output"));
+fail "missing paging statistics of the children\n" if @stats != 4;
+my ($faults, $ticks) = (0, 0);
+foreach (@stats) {
+    my ($f, $t) = /(\d+) page faults in (\d+) ticks/;
+    $faults += $f;
+    $ticks += $t;
+}
+printf STDOUT ("%s: %d page faults in %d ticks (%.4f ticks per fault)\n",
+	       $test, $faults, $ticks, $faults ? $ticks / $faults : 0);
+check_expected (IGNORE_EXIT_CODES => 1, IGNORE_VM_STATS => 1, [<<'EOF']);
+(page-parallel-timed) begin
+(page-parallel-timed) exec "child-linear"
+(page-parallel-timed) exec "child-linear"
+(page-parallel-timed) exec "child-linear"
+(page-parallel-timed) exec "child-linear"
+(page-parallel-timed) wait for child 0
+(page-parallel-timed) wait for child 1
+(page-parallel-timed) wait for child 2
+(page-parallel-timed) wait for child 3
+(page-parallel-timed) end
+EOF
+pass;
@@ -41,6 +41,7 @@
 #endif
 #ifdef VM
 #include "vm/swap.h"
+#include "vm/vm_util.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -57,6 +58,9 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -cache: Number of sectors in the buffer cache. */
+static size_t cache_sector_cnt = CACHE_DEFAULT_SECTOR_COUNT;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -127,7 +131,7 @@ main (void)
 
 #ifdef FILESYS
   /* Initialize file system. */
-  cache_init();
+  cache_init (cache_sector_cnt);
   ide_init ();
   locate_block_devices ();
   filesys_init (format_filesys);
@@ -259,9 +263,27 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-cache"))
+        {
+          cache_sector_cnt = atoi (value);
+          if (cache_sector_cnt < CACHE_MIN_SECTOR_COUNT)
+            PANIC ("buffer cache needs at least %d sectors",
+                   CACHE_MIN_SECTOR_COUNT);
+        }
+      else if (!strcmp (name, "-crash"))
+        filesys_simulate_crash ();
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-ws"))
+        {
+          int sweeps = atoi (value);
+          if (sweeps < 1 || sweeps > 8)
+            PANIC ("working set window must be 1 to 8 sweeps");
+          vm_set_working_set_sweeps (sweeps);
+        }
+      else if (!strcmp (name, "-vmstats"))
+        vm_enable_process_stats ();
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
@@ -385,8 +407,12 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -cache=COUNT       Keep COUNT sectors in the buffer cache.\n"
+          "  -crash             Power off without writing the file system back.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -ws=SWEEPS         Keep pages in working set for SWEEPS clock sweeps.\n"
+          "  -vmstats           Print paging statistics of each process on exit.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
@@ -148,6 +148,29 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Stores the first page of the user pool in *BASE and the number
+   of pages in it in *PAGE_CNT.  The pages of the user pool are
+   contiguous, so a user page's index is its distance from *BASE. */
+void
+palloc_user_pool (void **base, size_t *page_cnt)
+{
+  *base = user_pool.base;
+  *page_cnt = bitmap_size (user_pool.used_map);
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free_cnt (void)
+{
+  size_t cnt;
+
+  lock_acquire (&user_pool.lock);
+  cnt = bitmap_count (user_pool.used_map, 0, bitmap_size (user_pool.used_map),
+                      false);
+  lock_release (&user_pool.lock);
+  return cnt;
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -133,6 +133,7 @@ struct thread
 
 #ifdef FILESYS
     struct dir *pwd;                           /* Current working directory */
+    int journal_depth;                         /* Nesting of open journal handles. */
 #endif
 
     /* Owned by thread.c. */
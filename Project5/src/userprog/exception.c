@@ -7,6 +7,7 @@
 #ifdef VM
 #include "vm/supplemental_page.h"
 #include "vm/vm_util.h"
+#include "devices/timer.h"
 #endif
 
 /* Number of page faults processed. */
@@ -155,16 +156,17 @@ page_fault (struct intr_frame *f)
 #ifdef VM
   struct thread *cur = thread_current();
   if (not_present && cur != NULL && cur->suppl_page_table != NULL) {
+	  int64_t start = timer_ticks();
+	  bool handled = false;
 	  struct suppl_page *page = suppl_pt_lookup(cur->suppl_page_table, fault_addr);
 	  if (page != NULL) {
-		  if (page->location == PG_LOCATION_SWAP) {
-			  if (restore_page_from_swap(page, true)) return;
-		  } else if (page->location == PG_LOCATION_FILE) {
-			  if (suppl_page_load_from_file(page)) return;
-		  }
+		  handled = fault_in_page(page);
 	  } else if (stack_grow_needed(fault_addr, f->esp)) {
-		  if (suppl_table_alloc_user_page(cur, fault_addr, true)) return;
+		  handled = suppl_table_alloc_user_page(cur, fault_addr, true);
 	  }
+	  cur->suppl_page_table->fault_cnt++;
+	  cur->suppl_page_table->fault_ticks += timer_elapsed(start);
+	  if (handled) return;
   }
 #endif
 
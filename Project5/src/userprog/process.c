@@ -138,6 +138,10 @@ process_exit (void)
   uint32_t *pd;
 
   if (cur->executable_name != NULL) printf("%s: exit(%d)\n", cur->executable_name, cur->exit_status);
+#ifdef VM
+  /* Needs executable_name, which is freed below. */
+  vm_print_process_stats(cur);
+#endif
   if (cur->executable_name != NULL) palloc_free_page((void*)cur->executable_name);
   if (cur->executable_file != NULL) {
 	  file_allow_write(cur->executable_file);
@@ -526,9 +530,8 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	  struct suppl_page *spage = suppl_pt_lookup(thread_current()->suppl_page_table, upage);
 	  ASSERT(spage != NULL);
 	  spage->dirty = true;
-	  spage->accessed = true;
 	  if (read_bytes > 0)
-		  list_remove(&spage->list_elem);
+		  undo_suppl_page_registration(spage);
 #endif
 
       /* Advance. */
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
+#include <iovec.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
@@ -16,8 +17,8 @@
 #include "vm/file_mapping.h"
 #include "vm/vm_util.h"
 #endif
-#ifdef FILESYS
 #include "filesys/inode.h"
+#ifdef FILESYS
 #include "filesys/directory.h"
 #endif
 
@@ -46,9 +47,10 @@ static int user_address_valid(void *addr) {
 	else if (pagedir_get_page(cur->pagedir, (uint32_t *)addr) != NULL) return true;
 	else {
 #ifdef VM
-		if (suppl_pt_lookup(cur->suppl_page_table, addr) == NULL)
-			if (stack_grow_needed((const void*)addr, (const void*)(cur->intr_stack)))
-				if (suppl_table_alloc_user_page(cur, addr, true)) return true;
+		// Pages, that are not in RAM, are brought in by a page fault or by pinning.
+		if (suppl_pt_lookup(cur->suppl_page_table, addr) != NULL) return true;
+		if (stack_grow_needed((const void*)addr, (const void*)(cur->intr_stack)))
+			if (suppl_table_alloc_user_page(cur, addr, true)) return true;
 #endif
 		return false;
 	}
@@ -227,14 +229,14 @@ processes, each open returns a new file descriptor. Different file descriptors f
 file are closed independently in separate calls to close and they do not share a file
 position.
 */
-static int open(const char *file) {
+static int open_at(struct dir *base, const char *file) {
 	if (!string_valid(file)) exit(-1);
 	else {
 		struct thread *this_thread = thread_current();
 		
 		file_descriptor fd = thread_get_free_fd(this_thread);
 		if (fd >= 0) {
-			struct file *opened_file = filesys_open(file);
+			struct file *opened_file = filesys_open_at(base, file);
 			if (opened_file != NULL) {
 				if (!thread_set_file(this_thread, opened_file, fd)) {
 					file_close(opened_file);
@@ -249,6 +251,9 @@ static int open(const char *file) {
 	}
 	return -1;
 }
+static int open(const char *file) {
+	return open_at(NULL, file);
+}
 
 
 /**
@@ -261,6 +266,52 @@ static int filesize(int fd) {
 }
 
 
+// Pins the pages of the buffer in RAM, so that the file system never faults on them while it holds
+// its locks. Returns false, if the buffer can't be brought to RAM.
+static bool buffer_pin(const void *buffer, unsigned size) {
+#ifdef VM
+	return pin_user_buffer(buffer, size);
+#else
+	(void) buffer;
+	(void) size;
+	return true;
+#endif
+}
+
+// Unpins the pages of the buffer, pinned by buffer_pin.
+static void buffer_unpin(const void *buffer, unsigned size) {
+#ifdef VM
+	unpin_user_buffer(buffer, size);
+#else
+	(void) buffer;
+	(void) size;
+#endif
+}
+
+// Pins the array IOV of CNT buffers and the buffers in it. Returns false (with nothing pinned), if
+// any of them can't be brought to RAM.
+static bool iov_pin(const struct iovec *iov, int cnt) {
+	if (!buffer_pin(iov, cnt * sizeof(struct iovec))) return false;
+	int i;
+	for (i = 0; i < cnt; i++)
+		if (!buffer_pin(iov[i].iov_base, iov[i].iov_len)) {
+			while (i-- > 0)
+				buffer_unpin(iov[i].iov_base, iov[i].iov_len);
+			buffer_unpin(iov, cnt * sizeof(struct iovec));
+			return false;
+		}
+	return true;
+}
+
+// Unpins the buffers, pinned by iov_pin.
+static void iov_unpin(const struct iovec *iov, int cnt) {
+	int i;
+	for (i = 0; i < cnt; i++)
+		buffer_unpin(iov[i].iov_base, iov[i].iov_len);
+	buffer_unpin(iov, cnt * sizeof(struct iovec));
+}
+
+
 /**
 Reads size bytes from the file open as fd into buffer. Returns the number of bytes
 actually read (0 at end of file), or -1 if the file could not be read (due to a condition
@@ -282,7 +333,10 @@ static int read(int fd, void *buffer, unsigned size) {
 	else if (fd == STDOUT_FILENO) return 0;
 	else {
 		struct file *file_ptr = thread_get_file(thread_current(), fd);
-		int rv = ((file_ptr != NULL) ? file_read(file_ptr, (void*)buffer, size) : 0);
+		if (file_ptr == NULL) return 0;
+		if (!buffer_pin(buffer, size)) exit(-1);
+		int rv = file_read(file_ptr, (void*)buffer, size);
+		buffer_unpin(buffer, size);
 		return rv;
 	}
 	return 0;
@@ -323,13 +377,139 @@ static int write(int fd, const void *buffer, unsigned size) {
         /* Forbid writing to directory */
         if (file_is_dir(file_ptr))
             return -1;
-		int rv = ((file_ptr != NULL) ? file_write(file_ptr, (void*)buffer, size) : 0);
+		if (file_ptr == NULL) return 0;
+		if (!buffer_pin(buffer, size)) exit(-1);
+		int rv = file_write(file_ptr, (void*)buffer, size);
+		buffer_unpin(buffer, size);
 		return rv;
 	}
 	return 0;
 }
 
 
+// Checks the array IOV of CNT buffers and the buffers in it, each of them once; the process
+// is killed, if any is not valid. Returns false, if CNT or the total length is out of range.
+static bool iov_valid(const struct iovec *iov, int cnt, bool writable) {
+	if (cnt < 0 || cnt > IOV_MAX) return false;
+	if (!pointers_valid(iov, cnt * sizeof(struct iovec))) exit(-1);
+	size_t total = 0;
+	int i;
+	for (i = 0; i < cnt; i++) {
+		if (!pointers_valid(iov[i].iov_base, iov[i].iov_len)) exit(-1);
+#ifdef VM
+		if (writable && !pointers_writable(iov[i].iov_base, iov[i].iov_len)) exit(-1);
+#else
+		(void) writable;
+#endif
+		total += iov[i].iov_len;
+		if (total > INT32_MAX) return false;
+	}
+	return true;
+}
+
+// Returns true, if SIZE bytes starting at OFFSET all lie within the range of off_t.
+static bool offset_range_valid(unsigned offset, unsigned size) {
+	return (offset <= INT32_MAX && size <= INT32_MAX - offset);
+}
+
+
+/**
+Reads size bytes from the file open as fd into buffer, starting at byte offset
+offset in the file. The position of the file is not changed. Returns the number of
+bytes actually read (0 at end of file), or -1 if fd is not an open file or the
+range does not fit in a file offset.
+*/
+static int pread(int fd, void *buffer, unsigned size, unsigned offset) {
+	if (!pointers_valid(buffer, size)) exit(-1);
+#ifdef VM
+	if (!pointers_writable(buffer, size)) exit(-1);
+#endif
+	struct file *file_ptr = thread_get_file(thread_current(), fd);
+	if (file_ptr == NULL || file_is_dir(file_ptr)) return -1;
+	if (!offset_range_valid(offset, size)) return -1;
+	if (!buffer_pin(buffer, size)) exit(-1);
+	int rv = file_read_at(file_ptr, buffer, size, offset);
+	buffer_unpin(buffer, size);
+	return rv;
+}
+
+
+/**
+Writes size bytes from buffer to the file open as fd, starting at byte offset offset
+in the file, which grows, if needed. The position of the file is not changed. Returns
+the number of bytes actually written, or -1 if fd is not an open file or the range
+does not fit in a file offset.
+*/
+static int pwrite(int fd, const void *buffer, unsigned size, unsigned offset) {
+	if (!pointers_valid(buffer, size)) exit(-1);
+	struct file *file_ptr = thread_get_file(thread_current(), fd);
+	if (file_ptr == NULL || file_is_dir(file_ptr)) return -1;
+	if (!offset_range_valid(offset, size)) return -1;
+	if (!buffer_pin(buffer, size)) exit(-1);
+	int rv = file_write_at(file_ptr, buffer, size, offset);
+	buffer_unpin(buffer, size);
+	return rv;
+}
+
+
+/**
+Like read, but fills the iov_cnt buffers in iov, one after another, in a single pass
+over the file. Returns the total number of bytes read, or -1 if iov_cnt is out of range.
+*/
+static int readv(int fd, const struct iovec *iov, int iov_cnt) {
+	if (!iov_valid(iov, iov_cnt, true)) return -1;
+	if (fd == STDIN_FILENO) {
+		int i, total = 0;
+		for (i = 0; i < iov_cnt; i++) {
+			char *addr = iov[i].iov_base;
+			unsigned int j;
+			for (j = 0; j < iov[i].iov_len; j++)
+				addr[j] = input_getc();
+			total += iov[i].iov_len;
+		}
+		return total;
+	}
+	else if (fd == STDOUT_FILENO) return 0;
+	struct file *file_ptr = thread_get_file(thread_current(), fd);
+	if (file_ptr == NULL || file_is_dir(file_ptr)) return -1;
+	if (!iov_pin(iov, iov_cnt)) exit(-1);
+	int rv = file_readv(file_ptr, iov, iov_cnt);
+	iov_unpin(iov, iov_cnt);
+	return rv;
+}
+
+
+/**
+Like write, but writes the iov_cnt buffers in iov, one after another, in a single pass
+over the file. Returns the total number of bytes written, or -1 if iov_cnt is out of range.
+*/
+static int writev(int fd, const struct iovec *iov, int iov_cnt) {
+	if (!iov_valid(iov, iov_cnt, false)) return -1;
+	if (fd == STDOUT_FILENO) {
+		int i, total = 0;
+		for (i = 0; i < iov_cnt; i++) {
+			const char *addr = iov[i].iov_base;
+			unsigned int rem_size = iov[i].iov_len;
+			while (rem_size > 0) {
+				unsigned int to_write = min(CHUNCK_SIZE, rem_size);
+				putbuf(addr, to_write);
+				rem_size -= to_write;
+				addr += to_write;
+			}
+			total += iov[i].iov_len;
+		}
+		return total;
+	}
+	else if (fd == STDIN_FILENO) return 0;
+	struct file *file_ptr = thread_get_file(thread_current(), fd);
+	if (file_ptr == NULL || file_is_dir(file_ptr)) return -1;
+	if (!iov_pin(iov, iov_cnt)) exit(-1);
+	int rv = file_writev(file_ptr, iov, iov_cnt);
+	iov_unpin(iov, iov_cnt);
+	return rv;
+}
+
+
 /**
 Changes the next byte to be read or written in open file fd to position, expressed in
 bytes from the beginning of the file. (Thus, a position of 0 is the files start.)
@@ -477,6 +657,56 @@ static int inumber(int fd) {
 	return rv;
 }
 
+// Returns the directory open as fd, or NULL if fd is not an open directory.
+static struct dir *dir_by_fd(int fd) {
+	struct file *fl = thread_get_file(thread_current(), fd);
+	if (fl == NULL || !file_is_dir(fl)) return NULL;
+	return (struct dir *) fl;
+}
+
+/**
+Like open, but a relative file name is looked up starting from the directory
+open as dir_fd, instead of the working directory. Returns -1 if dir_fd is not
+an open directory.
+*/
+static int openat(int dir_fd, const char *file) {
+	struct dir *base = dir_by_fd(dir_fd);
+	if (!string_valid(file)) exit(-1);
+	if (base == NULL) return -1;
+	return open_at(base, file);
+}
+
+/**
+Like mkdir, but relative to the directory open as dir_fd.
+*/
+static bool mkdirat(int dir_fd, const char *dir) {
+	struct dir *base = dir_by_fd(dir_fd);
+	if (!string_valid(dir)) exit(-1);
+	if (base == NULL) return false;
+	return filesys_create_at(base, dir, INITIAL_DIR_SIZE, true);
+}
+
+/**
+Like remove, but relative to the directory open as dir_fd.
+*/
+static bool removeat(int dir_fd, const char *file) {
+	struct dir *base = dir_by_fd(dir_fd);
+	if (!string_valid(file)) exit(-1);
+	if (base == NULL) return false;
+	return filesys_remove_at(base, file);
+}
+
+/**
+Writes the cached sectors of the file or directory open as fd back to the disk.
+Returns 0 on success, or -1 if fd is not open.
+*/
+static int fsync(int fd) {
+	struct file *fl = thread_get_file(thread_current(), fd);
+	if (fl == NULL) return -1;
+	inode_flush(file_get_inode(fl));
+	return 0;
+}
+
 #endif
 
 
@@ -550,6 +780,22 @@ static void close_handler(struct intr_frame *f) {
 	if (!check_args(f, 1, 2)) exit(-1);
 	else EAX = close(I_PARAM(1));
 }
+static void pread_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 5)) exit(-1);
+	else EAX = pread(I_PARAM(1), V_PARAM(2), I_PARAM(3), I_PARAM(4));
+}
+static void pwrite_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 5)) exit(-1);
+	else EAX = pwrite(I_PARAM(1), V_PARAM(2), I_PARAM(3), I_PARAM(4));
+}
+static void readv_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 4)) exit(-1);
+	else EAX = readv(I_PARAM(1), V_PARAM(2), I_PARAM(3));
+}
+static void writev_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 4)) exit(-1);
+	else EAX = writev(I_PARAM(1), V_PARAM(2), I_PARAM(3));
+}
 #ifdef VM
 static void mmap_handler(struct intr_frame *f) {
 	if (!check_args(f, 1, 3)) exit(-1);
@@ -581,6 +827,22 @@ static void inumber_handler(struct intr_frame *f) {
 	if (!check_args(f, 1, 2)) exit(-1);
 	else EAX = inumber(I_PARAM(1));
 }
+static void openat_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 3)) exit(-1);
+	else EAX = openat(I_PARAM(1), S_PARAM(2));
+}
+static void mkdirat_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 3)) exit(-1);
+	else EAX = mkdirat(I_PARAM(1), S_PARAM(2));
+}
+static void removeat_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 3)) exit(-1);
+	else EAX = removeat(I_PARAM(1), S_PARAM(2));
+}
+static void fsync_handler(struct intr_frame *f) {
+	if (!check_args(f, 1, 2)) exit(-1);
+	else EAX = fsync(I_PARAM(1));
+}
 #endif
 
 #define MAX_SYS_CALL_ID \
@@ -608,8 +870,19 @@ static void inumber_handler(struct intr_frame *f) {
 						) \
 					), \
 					max( \
-						max(SYS_MKDIR, SYS_READDIR), \
-						max(SYS_ISDIR, SYS_INUMBER) \
+						max( \
+							max(SYS_MKDIR, SYS_READDIR), \
+							max(SYS_ISDIR, SYS_INUMBER) \
+						), \
+						max( \
+							max(SYS_OPENAT, SYS_MKDIRAT), \
+							max(SYS_REMOVEAT, \
+								max( \
+									max(SYS_PREAD, SYS_PWRITE), \
+									max(SYS_READV, max(SYS_WRITEV, SYS_FSYNC)) \
+								) \
+							) \
+						) \
 					) \
 				)
 
@@ -637,6 +910,10 @@ static void init_sys_handlers(void) {
 		sys_handlers[SYS_SEEK] = seek_handler;
 		sys_handlers[SYS_TELL] = tell_handler;
 		sys_handlers[SYS_CLOSE] = close_handler;
+		sys_handlers[SYS_PREAD] = pread_handler;
+		sys_handlers[SYS_PWRITE] = pwrite_handler;
+		sys_handlers[SYS_READV] = readv_handler;
+		sys_handlers[SYS_WRITEV] = writev_handler;
 #ifdef VM
 		sys_handlers[SYS_MMAP] = mmap_handler;
 		sys_handlers[SYS_MUNMAP] = munmap_handler;
@@ -647,6 +924,10 @@ static void init_sys_handlers(void) {
 		sys_handlers[SYS_READDIR] = readdir_handler;
 		sys_handlers[SYS_ISDIR] = isdir_handler;
 		sys_handlers[SYS_INUMBER] = inumber_handler;
+		sys_handlers[SYS_OPENAT] = openat_handler;
+		sys_handlers[SYS_MKDIRAT] = mkdirat_handler;
+		sys_handlers[SYS_REMOVEAT] = removeat_handler;
+		sys_handlers[SYS_FSYNC] = fsync_handler;
 #endif
 		sys_initialized = true;
 	}
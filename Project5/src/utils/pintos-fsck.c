@@ -0,0 +1,714 @@
+/* pintos-fsck: checks, and optionally repairs, the file system on a
+   Pintos disk image, without booting it.
+
+   The directory tree is walked from the root, and every sector an
+   inode, an extent or an extent block refers to is claimed for its
+   inode.  Sectors claimed twice, directory entries, that do not
+   refer to a valid inode, and differences between the claimed
+   sectors and the free map are reported.  The committed
+   transactions of the metadata journal are taken into account, as
+   the kernel would replay them on the next start.
+
+   The layout of the file system is that of filesys/inode.c,
+   filesys/directory.c, filesys/journal.c and lib/kernel/bitmap.c,
+   and has to be kept in sync with them. */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTOR_SIZE 512
+#define NO_SECTOR ((uint32_t) -1)
+
+/* Partition type of a Pintos file system (see Pintos.pm). */
+#define PART_TYPE_FILESYS 0x21
+
+/* filesys/filesys.h, filesys/journal.h. */
+#define FREE_MAP_SECTOR 0
+#define ROOT_DIR_SECTOR 1
+#define JOURNAL_SECTOR 2
+#define JOURNAL_LOG_SECTORS 64
+
+/* filesys/inode.c. */
+#define INODE_MAGIC 0x494e4f44
+#define INODE_FORMAT_VERSION 4
+#define INODE_FLAG_DIR 1
+#define INODE_DIRECT_EXTENTS 40
+#define EXTENT_BLOCK_EXTENTS 42
+
+/* filesys/journal.c. */
+#define JOURNAL_MAGIC 0x4a524e4c
+#define JOURNAL_TX_MAX (JOURNAL_LOG_SECTORS / 2 - 1)
+#define JOURNAL_HEADER_SECTORS 123
+#define JOURNAL_REVOKE_MAX (JOURNAL_HEADER_SECTORS - JOURNAL_TX_MAX)
+#define LOG_START (JOURNAL_SECTOR + 1)
+#define LOG_END (LOG_START + JOURNAL_LOG_SECTORS)
+
+/* filesys/directory.h. */
+#define NAME_MAX 25
+
+struct extent
+  {
+    uint32_t first;
+    uint32_t start;
+    uint32_t length;
+  };
+
+struct extent_block
+  {
+    uint32_t next;
+    uint32_t unused;
+    struct extent extents[EXTENT_BLOCK_EXTENTS];
+  };
+
+struct inode_disk
+  {
+    int32_t length;
+    uint32_t magic;
+    uint32_t flags;
+    uint32_t extent_cnt;
+    uint32_t extent_block;
+    struct extent direct[INODE_DIRECT_EXTENTS];
+    uint32_t version;
+    uint32_t unused[2];
+  };
+
+struct dir_entry
+  {
+    uint32_t inode_sector;
+    char name[NAME_MAX + 1];
+    bool in_use;
+  };
+
+struct journal_super
+  {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t unused[126];
+  };
+
+struct journal_header
+  {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t cnt;
+    uint32_t revoke_cnt;
+    uint32_t checksum;
+    uint32_t sectors[JOURNAL_HEADER_SECTORS];
+  };
+
+/* An inode, as far as the checks are concerned. */
+struct inode
+  {
+    uint32_t sector;
+    struct inode_disk disk;
+    struct extent *extents;             /* All the extents, in order. */
+    uint32_t extent_cnt;
+    uint32_t sectors;                   /* Data sectors mapped. */
+  };
+
+static const char *program_name;
+static FILE *disk;
+static long part_start;                 /* First sector of the partition. */
+static uint32_t part_size;              /* Sectors in the partition. */
+static bool repair;
+static bool verbose;
+
+static uint8_t **overlay;               /* Replayed journal images, by sector. */
+static uint32_t *owner;                 /* Inode claiming each sector, or NO_SECTOR. */
+
+static unsigned long error_cnt;         /* Problems found. */
+static unsigned long fixed_cnt;         /* Problems repaired. */
+
+/* Fragmentation statistics. */
+static unsigned long file_cnt, dir_cnt;
+static unsigned long data_sector_cnt;
+static unsigned long fragment_cnt;      /* Runs of contiguous data sectors, over all files. */
+static unsigned long fragmented_cnt;    /* Files with more than one run. */
+static unsigned long max_fragments;
+
+static void
+fail (const char *format, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "%s: ", program_name);
+  va_start (args, format);
+  vfprintf (stderr, format, args);
+  va_end (args);
+  putc ('\n', stderr);
+  exit (8);
+}
+
+/* Reports a problem with the file system. */
+static void
+problem (const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+  error_cnt++;
+}
+
+static void *
+xmalloc (size_t size)
+{
+  void *p = calloc (1, size);
+  if (p == NULL)
+    fail ("out of memory");
+  return p;
+}
+
+/* Reads SECTOR of the partition into BUF, as the kernel would see
+   it after replaying the journal.  Returns false if SECTOR is past
+   the end of the partition. */
+static bool
+read_sector (uint32_t sector, void *buf)
+{
+  if (sector >= part_size)
+    return false;
+  if (overlay[sector] != NULL)
+    memcpy (buf, overlay[sector], SECTOR_SIZE);
+  else if (fseek (disk, (part_start + sector) * SECTOR_SIZE, SEEK_SET) != 0
+           || fread (buf, SECTOR_SIZE, 1, disk) != 1)
+    fail ("reading sector %lu: %s", part_start + sector, strerror (errno));
+  return true;
+}
+
+/* Writes BUF to SECTOR of the partition. */
+static void
+write_sector (uint32_t sector, const void *buf)
+{
+  if (sector >= part_size)
+    fail ("writing sector %lu: past the end of the partition",
+          (unsigned long) sector);
+  if (overlay[sector] != NULL)
+    memcpy (overlay[sector], buf, SECTOR_SIZE);
+  if (fseek (disk, (part_start + sector) * SECTOR_SIZE, SEEK_SET) != 0
+      || fwrite (buf, SECTOR_SIZE, 1, disk) != 1)
+    fail ("writing sector %lu: %s", part_start + sector, strerror (errno));
+}
+
+/* Finds the file system partition in the partition table of the
+   disk, or takes the whole disk, if it has no partition table. */
+static void
+find_partition (void)
+{
+  uint8_t mbr[SECTOR_SIZE];
+  long size;
+  int i;
+
+  if (fseek (disk, 0, SEEK_END) != 0 || (size = ftell (disk)) < 0)
+    fail ("can't determine the size of the disk: %s", strerror (errno));
+  rewind (disk);
+  if (fread (mbr, SECTOR_SIZE, 1, disk) != 1)
+    fail ("disk is shorter than a sector");
+
+  part_start = 0;
+  part_size = size / SECTOR_SIZE;
+  if (mbr[510] != 0x55 || mbr[511] != 0xaa)
+    return;
+  for (i = 0; i < 4; i++)
+    {
+      const uint8_t *e = mbr + 446 + 16 * i;
+      if (e[4] == PART_TYPE_FILESYS)
+        {
+          part_start = e[8] | e[9] << 8 | e[10] << 16 | (uint32_t) e[11] << 24;
+          part_size = e[12] | e[13] << 8 | e[14] << 16 | (uint32_t) e[15] << 24;
+          if (part_start + part_size > size / SECTOR_SIZE)
+            fail ("file system partition extends past the end of the disk");
+          return;
+        }
+    }
+  fail ("disk has a partition table, but no file system partition");
+}
+
+/* Fowler-Noll-Vo hash, as hash_bytes() in lib/kernel/hash.c. */
+static uint32_t
+hash_bytes (const void *buf_, size_t size)
+{
+  const uint8_t *buf = buf_;
+  uint32_t hash = 2166136261u;
+
+  while (size-- > 0)
+    hash = (hash * 16777619u) ^ *buf++;
+  return hash;
+}
+
+/* Returns true if one of the CNT transactions, whose headers are at
+   the offsets LOG into the log buffer BUF, revokes SECTOR. */
+static bool
+revoked (const uint8_t *buf, const uint32_t *log, uint32_t cnt,
+         uint32_t sector)
+{
+  uint32_t i, j;
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct journal_header *h
+        = (const struct journal_header *) (buf + log[i] * SECTOR_SIZE);
+      for (j = 0; j < h->revoke_cnt; j++)
+        if (h->sectors[h->cnt + j] == sector)
+          return true;
+    }
+  return false;
+}
+
+/* Loads the committed transactions of the journal into the
+   overlay, except for the images of sectors revoked by the same or
+   a later transaction.  With REPAIR, writes them to their home
+   locations and empties the log, as the kernel does at start. */
+static void
+replay_journal (void)
+{
+  struct journal_super super;
+  static uint8_t buf[JOURNAL_LOG_SECTORS * SECTOR_SIZE];
+  uint32_t log[JOURNAL_LOG_SECTORS];
+  uint32_t pos = 0;
+  uint32_t seq, i, j;
+  uint32_t cnt = 0;
+
+  if (!read_sector (JOURNAL_SECTOR, &super) || super.magic != JOURNAL_MAGIC)
+    {
+      problem ("journal superblock is missing (old or unknown format?)");
+      return;
+    }
+  for (i = 0; i < JOURNAL_LOG_SECTORS; i++)
+    read_sector (LOG_START + i, buf + i * SECTOR_SIZE);
+
+  seq = super.seq;
+  while (pos < JOURNAL_LOG_SECTORS)
+    {
+      const struct journal_header *h
+        = (const struct journal_header *) (buf + pos * SECTOR_SIZE);
+      if (h->magic != JOURNAL_MAGIC || h->seq != seq
+          || h->cnt + h->revoke_cnt == 0 || h->cnt > JOURNAL_TX_MAX
+          || h->revoke_cnt > JOURNAL_REVOKE_MAX
+          || pos + 1 + h->cnt > JOURNAL_LOG_SECTORS
+          || h->checksum != hash_bytes (buf + (pos + 1) * SECTOR_SIZE,
+                                        h->cnt * SECTOR_SIZE))
+        break;
+      log[cnt++] = pos;
+      pos += h->cnt + 1;
+      seq++;
+    }
+
+  for (i = 0; i < cnt; i++)
+    {
+      const struct journal_header *h
+        = (const struct journal_header *) (buf + log[i] * SECTOR_SIZE);
+      for (j = 0; j < h->cnt; j++)
+        {
+          uint32_t sector = h->sectors[j];
+          if (sector >= part_size)
+            {
+              problem ("journal: transaction %lu logs sector %lu, "
+                       "past the end of the partition",
+                       (unsigned long) h->seq, (unsigned long) sector);
+              continue;
+            }
+          if (revoked (buf, log + i, cnt - i, sector))
+            continue;
+          if (overlay[sector] == NULL)
+            overlay[sector] = xmalloc (SECTOR_SIZE);
+          memcpy (overlay[sector], buf + (log[i] + 1 + j) * SECTOR_SIZE,
+                  SECTOR_SIZE);
+        }
+    }
+
+  if (cnt == 0)
+    return;
+  printf ("journal: %lu committed transactions %s\n", (unsigned long) cnt,
+          repair ? "replayed" : "to be replayed at the next start");
+  if (repair)
+    {
+      for (i = 0; i < part_size; i++)
+        if (overlay[i] != NULL)
+          write_sector (i, overlay[i]);
+      super.seq = seq;
+      write_sector (JOURNAL_SECTOR, &super);
+    }
+}
+
+/* Claims SECTOR for inode INODE, as WHAT.  Returns false if it is
+   out of range or claimed already. */
+static bool
+claim (uint32_t sector, uint32_t inode, const char *what)
+{
+  if (sector >= part_size)
+    {
+      problem ("inode %lu: %s sector %lu is past the end of the partition",
+               (unsigned long) inode, what, (unsigned long) sector);
+      return false;
+    }
+  if (owner[sector] != NO_SECTOR)
+    {
+      problem ("sector %lu is allocated twice: as %s of inode %lu and "
+               "by inode %lu", (unsigned long) sector, what,
+               (unsigned long) inode, (unsigned long) owner[sector]);
+      return false;
+    }
+  owner[sector] = inode;
+  return true;
+}
+
+/* Reads and checks the inode in SECTOR and claims its sectors.
+   Returns false, if it is not a valid inode. */
+static bool
+load_inode (uint32_t sector, struct inode *inode)
+{
+  struct inode_disk *d = &inode->disk;
+  uint32_t block, i, j, need, end = 0;
+  bool sparse;
+
+  inode->sector = sector;
+  inode->extents = NULL;
+  inode->extent_cnt = inode->sectors = 0;
+  if (!read_sector (sector, d) || d->magic != INODE_MAGIC)
+    return false;
+  if (d->version != INODE_FORMAT_VERSION)
+    {
+      problem ("inode %lu: format version %lu, expected %d",
+               (unsigned long) sector, (unsigned long) d->version,
+               INODE_FORMAT_VERSION);
+      return false;
+    }
+  if (!claim (sector, sector, "the inode"))
+    return false;
+  sparse = !(d->flags & INODE_FLAG_DIR) && sector != FREE_MAP_SECTOR;
+
+  /* Collect the extents. */
+  inode->extents = xmalloc ((d->extent_cnt + 1) * sizeof (struct extent));
+  for (i = 0; i < d->extent_cnt && i < INODE_DIRECT_EXTENTS; i++)
+    inode->extents[i] = d->direct[i];
+  block = d->extent_block;
+  while (i < d->extent_cnt)
+    {
+      struct extent_block b;
+      if (block == NO_SECTOR || !claim (block, sector, "an extent block"))
+        {
+          problem ("inode %lu: %lu of its %lu extents are missing",
+                   (unsigned long) sector,
+                   (unsigned long) (d->extent_cnt - i),
+                   (unsigned long) d->extent_cnt);
+          break;
+        }
+      read_sector (block, &b);
+      for (j = 0; j < EXTENT_BLOCK_EXTENTS && i < d->extent_cnt; j++)
+        inode->extents[i++] = b.extents[j];
+      block = b.next;
+    }
+  inode->extent_cnt = i;
+
+  /* Claim the data sectors.  Files may have holes between their
+     extents, directories and the free map may not. */
+  for (i = 0; i < inode->extent_cnt; i++)
+    {
+      const struct extent *e = inode->extents + i;
+      if (e->first < end)
+        problem ("inode %lu: extent %lu maps data sector %lu, "
+                 "which is mapped already", (unsigned long) sector,
+                 (unsigned long) i, (unsigned long) e->first);
+      else if (e->first > end && !sparse)
+        problem ("inode %lu: data sectors %lu...%lu are missing",
+                 (unsigned long) sector, (unsigned long) end,
+                 (unsigned long) e->first - 1);
+      for (j = 0; j < e->length; j++)
+        claim (e->start + j, sector, "data");
+      inode->sectors += e->length;
+      end = e->first + e->length;
+    }
+  need = (d->length + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  if (d->length < 0 || (!sparse && end < need))
+    problem ("inode %lu: %ld bytes long, but has only %lu data sectors",
+             (unsigned long) sector, (long) d->length, (unsigned long) end);
+  return true;
+}
+
+/* Returns the disk sector of data sector INDEX of INODE, or
+   NO_SECTOR. */
+static uint32_t
+data_sector (const struct inode *inode, uint32_t index)
+{
+  uint32_t i;
+
+  for (i = 0; i < inode->extent_cnt; i++)
+    {
+      const struct extent *e = inode->extents + i;
+      if (index >= e->first && index < e->first + e->length)
+        return e->start + (index - e->first);
+    }
+  return NO_SECTOR;
+}
+
+/* Prints the fragmentation of INODE, at PATH, and adds it to the
+   totals. */
+static void
+report_fragments (const struct inode *inode, const char *path)
+{
+  unsigned long runs = 0;
+  uint32_t i;
+
+  for (i = 0; i < inode->extent_cnt; i++)
+    if (i == 0 || inode->extents[i].start
+                  != inode->extents[i - 1].start + inode->extents[i - 1].length)
+      runs++;
+  if (inode->disk.flags & INODE_FLAG_DIR)
+    dir_cnt++;
+  else
+    file_cnt++;
+  data_sector_cnt += inode->sectors;
+  fragment_cnt += runs;
+  if (runs > 1)
+    fragmented_cnt++;
+  if (runs > max_fragments)
+    max_fragments = runs;
+  if (verbose || runs > 1)
+    printf ("%-40s inode %6lu %9ld bytes %6lu sectors %4lu extents %4lu runs\n",
+            path, (unsigned long) inode->sector, (long) inode->disk.length,
+            (unsigned long) inode->sectors, (unsigned long) inode->extent_cnt,
+            runs);
+}
+
+static void check_dir (struct inode *dir, uint32_t parent, const char *path);
+
+/* Checks entry I of directory DIR, at PATH, whose parent is in
+   sector PARENT.  E points into ENTRIES, the contents of directory
+   data sector SECTOR, which is written back if E is repaired. */
+static void
+check_dir_entry (struct inode *dir, uint32_t parent, const char *path,
+                 uint32_t sector, struct dir_entry *entries,
+                 struct dir_entry *e, uint32_t i)
+{
+  struct inode child;
+  char *child_path;
+  bool valid;
+
+  if (!e->in_use)
+    return;
+  if (memchr (e->name, '\0', sizeof e->name) == NULL)
+    {
+      problem ("%s: entry %lu has an unterminated name", path,
+               (unsigned long) i);
+      e->name[NAME_MAX] = '\0';
+    }
+  if (!strcmp (e->name, ".") || !strcmp (e->name, ".."))
+    {
+      uint32_t expected = e->name[1] ? parent : dir->sector;
+      if (e->inode_sector != expected)
+        problem ("%s: \"%s\" refers to inode %lu, expected %lu", path,
+                 e->name, (unsigned long) e->inode_sector,
+                 (unsigned long) expected);
+      return;
+    }
+
+  child_path = xmalloc (strlen (path) + strlen (e->name) + 2);
+  sprintf (child_path, "%s%s%s", path, path[1] ? "/" : "", e->name);
+  child.extents = NULL;
+  valid = (e->inode_sector < part_size
+           && owner[e->inode_sector] == NO_SECTOR
+           && load_inode (e->inode_sector, &child));
+  if (!valid)
+    {
+      problem ("%s: refers to inode %lu, which is not a valid inode "
+               "or in use elsewhere", child_path,
+               (unsigned long) e->inode_sector);
+      if (repair)
+        {
+          e->in_use = false;
+          write_sector (sector, entries);
+          fixed_cnt++;
+        }
+    }
+  else
+    {
+      report_fragments (&child, child_path);
+      if (child.disk.flags & INODE_FLAG_DIR)
+        check_dir (&child, dir->sector, child_path);
+    }
+  free (child.extents);
+  free (child_path);
+}
+
+/* Checks directory DIR, at PATH, whose parent is in sector PARENT,
+   and everything in it. */
+static void
+check_dir (struct inode *dir, uint32_t parent, const char *path)
+{
+  const uint32_t per_sector = SECTOR_SIZE / sizeof (struct dir_entry);
+  uint32_t cnt = dir->disk.length / sizeof (struct dir_entry);
+  uint32_t i, j;
+
+  for (i = 0; i < cnt; i += per_sector)
+    {
+      struct dir_entry entries[SECTOR_SIZE / sizeof (struct dir_entry)];
+      uint32_t sector = data_sector (dir, i / per_sector);
+
+      if (sector == NO_SECTOR || !read_sector (sector, entries))
+        break;
+      for (j = 0; j < per_sector && i + j < cnt; j++)
+        check_dir_entry (dir, parent, path, sector, entries, entries + j,
+                         i + j);
+    }
+}
+
+/* Compares the sectors claimed by the inodes with the free map
+   and, with REPAIR, makes the free map match them. */
+static void
+check_free_map (const struct inode *map)
+{
+  uint32_t byte_cnt = (part_size + 31) / 32 * 4;
+  uint32_t sector_cnt = (byte_cnt + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  uint8_t *bits = xmalloc (sector_cnt * SECTOR_SIZE);
+  unsigned long leaked = 0, unmarked = 0, free_runs = 0, free_cnt = 0;
+  unsigned long run = 0, largest_run = 0;
+  uint32_t i;
+  bool changed = false;
+
+  if ((uint32_t) map->disk.length < byte_cnt || map->sectors < sector_cnt)
+    {
+      problem ("free map: %ld bytes long, expected %lu",
+               (long) map->disk.length, (unsigned long) byte_cnt);
+      free (bits);
+      return;
+    }
+  for (i = 0; i < sector_cnt; i++)
+    read_sector (data_sector (map, i), bits + i * SECTOR_SIZE);
+
+  for (i = 0; i < part_size; i++)
+    {
+      bool marked = (bits[i / 8] >> (i % 8)) & 1;
+      bool used = (owner[i] != NO_SECTOR);
+
+      if (marked && !used)
+        {
+          if (leaked++ < 10 || verbose)
+            printf ("sector %lu is leaked: allocated, but not used\n",
+                    (unsigned long) i);
+        }
+      else if (!marked && used)
+        {
+          if (unmarked++ < 10 || verbose)
+            printf ("sector %lu is used by inode %lu, but free in the "
+                    "free map\n", (unsigned long) i, (unsigned long) owner[i]);
+        }
+      if (marked != used && repair)
+        {
+          bits[i / 8] ^= 1 << (i % 8);
+          changed = true;
+        }
+
+      if (!used)
+        {
+          free_cnt++;
+          if (run++ == 0)
+            free_runs++;
+          if (run > largest_run)
+            largest_run = run;
+        }
+      else
+        run = 0;
+    }
+  error_cnt += leaked + unmarked;
+  if (leaked + unmarked > 0)
+    printf ("free map: %lu leaked sectors, %lu used sectors marked free\n",
+            leaked, unmarked);
+
+  if (changed)
+    {
+      for (i = 0; i < sector_cnt; i++)
+        write_sector (data_sector (map, i), bits + i * SECTOR_SIZE);
+      fixed_cnt += leaked + unmarked;
+    }
+  printf ("free space: %lu sectors in %lu runs, the largest %lu sectors\n",
+          free_cnt, free_runs, largest_run);
+  free (bits);
+}
+
+static void
+usage (void)
+{
+  printf ("%s: checks the Pintos file system on a disk image\n"
+          "usage: %s [OPTION...] DISK\n"
+          "  -r, --repair   fix the problems found: replay the journal,\n"
+          "                 drop directory entries to invalid inodes and\n"
+          "                 rebuild the free map\n"
+          "  -v, --verbose  list every file, not just the fragmented ones,\n"
+          "                 and every free map mismatch\n"
+          "  -h, --help     print this help and exit\n",
+          program_name, program_name);
+  exit (0);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct inode map, root;
+  const char *disk_name = NULL;
+  uint32_t i;
+  int arg;
+
+  program_name = argv[0];
+  for (arg = 1; arg < argc; arg++)
+    {
+      if (!strcmp (argv[arg], "-r") || !strcmp (argv[arg], "--repair"))
+        repair = true;
+      else if (!strcmp (argv[arg], "-v") || !strcmp (argv[arg], "--verbose"))
+        verbose = true;
+      else if (!strcmp (argv[arg], "-h") || !strcmp (argv[arg], "--help"))
+        usage ();
+      else if (argv[arg][0] == '-' || disk_name != NULL)
+        fail ("invalid argument \"%s\" (use --help for help)", argv[arg]);
+      else
+        disk_name = argv[arg];
+    }
+  if (disk_name == NULL)
+    fail ("no disk specified (use --help for help)");
+
+  disk = fopen (disk_name, repair ? "r+b" : "rb");
+  if (disk == NULL)
+    fail ("%s: open: %s", disk_name, strerror (errno));
+  find_partition ();
+  if (part_size <= LOG_END)
+    fail ("file system partition has only %lu sectors",
+          (unsigned long) part_size);
+  overlay = xmalloc (part_size * sizeof *overlay);
+  owner = xmalloc (part_size * sizeof *owner);
+  for (i = 0; i < part_size; i++)
+    owner[i] = NO_SECTOR;
+
+  replay_journal ();
+  for (i = JOURNAL_SECTOR; i < LOG_END; i++)
+    owner[i] = JOURNAL_SECTOR;
+
+  if (!load_inode (FREE_MAP_SECTOR, &map))
+    fail ("free map inode is not valid, the disk is not a Pintos file system");
+  if (!load_inode (ROOT_DIR_SECTOR, &root)
+      || !(root.disk.flags & INODE_FLAG_DIR))
+    fail ("root directory inode is not valid");
+  report_fragments (&root, "/");
+  check_dir (&root, ROOT_DIR_SECTOR, "/");
+  check_free_map (&map);
+
+  printf ("%lu files, %lu directories, %lu data sectors\n",
+          file_cnt, dir_cnt, data_sector_cnt);
+  if (file_cnt + dir_cnt > 0)
+    printf ("fragmentation: %lu of them in more than one run, "
+            "%.2f runs on average, at most %lu\n",
+            fragmented_cnt, (double) fragment_cnt / (file_cnt + dir_cnt),
+            max_fragments);
+
+  if (fclose (disk) != 0)
+    fail ("%s: close: %s", disk_name, strerror (errno));
+  if (error_cnt == 0)
+    return 0;
+  printf ("%lu problems found, %lu repaired\n", error_cnt, fixed_cnt);
+  return fixed_cnt >= error_cnt ? 1 : 4;
+}
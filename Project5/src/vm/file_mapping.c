@@ -29,8 +29,10 @@ void file_mapping_dispose(struct thread *t, struct file_mapping *f) {
 		char *end = (cur_page + f->file_size - f->offset);
 		while (cur_page < end) {
 			struct suppl_page *page = suppl_pt_lookup(t->suppl_page_table, cur_page);
+			lock_acquire(&page->lock);
 			if (!suppl_page_load_to_file(page, false))
 				PANIC("\n############################### ERROR LOADING CHANGES TO THE FILE ##############################\n");
+			lock_release(&page->lock);
 			suppl_page_dispose(page);
 			hash_delete(&t->suppl_page_table->pages_map, &page->hash_elem);
 			free(page);
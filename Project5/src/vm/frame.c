@@ -0,0 +1,49 @@
+#include "frame.h"
+#include "lib/debug.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+// Frame table
+static struct frame *frames = NULL;
+// Number of frames
+static size_t frame_cnt = 0;
+// Kernel address of the first frame
+static uint8_t *user_base = NULL;
+
+// Allocates and initializes the frame table.
+void frame_table_init(void) {
+	void *base;
+	palloc_user_pool(&base, &frame_cnt);
+	user_base = base;
+	frames = calloc(frame_cnt, sizeof(struct frame));
+	if (frames == NULL && frame_cnt > 0)
+		PANIC("UNABLE TO ALLOCATE THE FRAME TABLE");
+}
+
+// Returns the number of frames.
+size_t frame_table_size(void) {
+	return frame_cnt;
+}
+
+// Returns the frame with the given number.
+struct frame *frame_at(size_t frame_no) {
+	ASSERT(frame_no < frame_cnt);
+	return (frames + frame_no);
+}
+
+// Returns the frame of the given kernel address (from the user pool).
+struct frame *frame_lookup(const void *kaddr) {
+	ASSERT(pg_ofs(kaddr) == 0 && (const uint8_t*)kaddr >= user_base);
+	return frame_at(((const uint8_t*)kaddr - user_base) / PGSIZE);
+}
+
+// Returns the kernel address of the frame.
+void *frame_kaddr(const struct frame *f) {
+	return (user_base + (f - frames) * PGSIZE);
+}
+
+// Returns true, if the frame can be evicted (has an owner and is not pinned).
+bool frame_evictable(const struct frame *f) {
+	return (f->page != NULL && f->pin_cnt == 0);
+}
@@ -0,0 +1,33 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+#include "lib/stdbool.h"
+#include "lib/stddef.h"
+#include "supplemental_page.h"
+
+/* Frame table: one entry per page of the user pool, indexed by the frame number (the distance
+	of the frame from the start of the pool). The table is allocated once, and it's synchronised
+	by the VM utilities (see vm_util.c). */
+
+// Frame table entry:
+struct frame {
+	struct suppl_page *page;	// Owner page (NULL, if the frame is free or not evictable)
+	int pin_cnt;				// Number of pins (pinned frames are never evicted)
+	uint8_t age;				// Accessed bits of the page, sampled by the clock hand (the latest first)
+};
+
+// Allocates and initializes the frame table.
+void frame_table_init(void);
+
+// Returns the number of frames.
+size_t frame_table_size(void);
+// Returns the frame with the given number.
+struct frame *frame_at(size_t frame_no);
+// Returns the frame of the given kernel address (from the user pool).
+struct frame *frame_lookup(const void *kaddr);
+// Returns the kernel address of the frame.
+void *frame_kaddr(const struct frame *f);
+
+// Returns true, if the frame can be evicted (has an owner and is not pinned).
+bool frame_evictable(const struct frame *f);
+
+#endif
@@ -39,12 +39,12 @@ void suppl_page_init(uint32_t *pagedir, struct suppl_page *page) {
     page->mapping = NULL;
 	page->location = PG_LOCATION_UNKNOWN;
 	page->dirty = false;
-	page->accessed = false;
 }
 
 // Allocates, initializes and returns an empty SP.
 struct suppl_page * suppl_page_new(uint32_t *pagedir) {
 	struct suppl_page * page = malloc(sizeof(struct suppl_page));
+	if (page != NULL) lock_init(&page->lock);
 	suppl_page_init(pagedir, page);
 	return page;
 }
@@ -53,6 +53,8 @@ struct suppl_page * suppl_page_new(uint32_t *pagedir) {
 void suppl_page_dispose(struct suppl_page *page) {
 	if (page == NULL) return;
 	if (page->pagedir == NULL) PANIC("\n########################## PAGE MISSING PAGEDIR ############################\n");
+	// Waits for the eviction of the page, if it's being written out right now.
+	lock_acquire(&page->lock);
 	if (page->kaddr != 0) {
 		undo_suppl_page_registration(page);
 		pagedir_clear_page_synch(page->pagedir, (void*)page->vaddr);
@@ -61,6 +63,7 @@ void suppl_page_dispose(struct suppl_page *page) {
 	if (page->saddr != SWAP_NO_PAGE)
 		swap_free_page(page->saddr);
     suppl_page_init(page->pagedir, page);
+	lock_release(&page->lock);
 }
 
 // Cleans and deallocates SP.
@@ -79,10 +82,6 @@ void suppl_page_delete(struct suppl_page *page) {
 bool suppl_page_dirty(struct suppl_page *page) {
 	BIT_CHECK_FN((page->dirty), pagedir_is_dirty);
 }
-// Returns true, if SP is/ever was accessed.
-bool suppl_page_accessed(struct suppl_page *page) {
-	BIT_CHECK_FN((page->accessed), pagedir_is_accessed);
-}
 #undef BIT_CHECK_FN
 
 // Restores/allocates SP if needed.
@@ -92,7 +91,7 @@ static bool set_kpage_if_needed(struct suppl_page *page, bool eviction_call) {
 	undo_suppl_page_registration(page);
 	bool kpage_new = (kpage == NULL);
 	if (kpage_new && (!suppl_page_dirty(page)))
-		kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+		kpage = get_free_kaddr();
 	if (kpage == NULL) {
 		if (page->location == PG_LOCATION_SWAP) {
 			return restore_page_from_swap(page, false);
@@ -113,9 +112,10 @@ static bool set_kpage_if_needed(struct suppl_page *page, bool eviction_call) {
 	return true;
 }
 
-// Loads page from file.
+// Loads page from file (the caller holds the page's lock).
 bool suppl_page_load_from_file(struct suppl_page *page) {
 	ASSERT(page->location == PG_LOCATION_FILE && page->mapping != NULL);
+	ASSERT(lock_held_by_current_thread(&page->lock));
 	if (page->mapping->fl == NULL) return false;
 	if (!set_kpage_if_needed(page, false)) return false;
 	char *start = ((char*)page->vaddr);
@@ -130,8 +130,10 @@ bool suppl_page_load_from_file(struct suppl_page *page) {
 				uint32_t buf_sz = (PAGE_SIZE - (buff - start));
 				uint32_t till_fl_end = (fl_end - buff);
 				if (till_fl_end < buf_sz) buf_sz = till_fl_end;
-				file_seek(page->mapping->fl, ((char*)buff) - ((char*)page->mapping->start_vaddr) + page->mapping->offset);
-				buff += file_read(page->mapping->fl, (((char*)pg_round_down((void*)page->kaddr)) + (buff - start)), buf_sz);
+				// The file is shared by all the pages of the mapping, and other pages are evicted meanwhile,
+				// so its position is never used.
+				off_t file_ofs = ((char*)buff) - ((char*)page->mapping->start_vaddr) + page->mapping->offset;
+				buff += file_read_at(page->mapping->fl, (((char*)pg_round_down((void*)page->kaddr)) + (buff - start)), buf_sz, file_ofs);
 			}
 			file_r = true;
 		}
@@ -152,10 +154,11 @@ bool suppl_page_load_from_file(struct suppl_page *page) {
 
 	return true;
 }
-// Loads page to file.
+// Loads page to file (the caller holds the page's lock).
 bool suppl_page_load_to_file(struct suppl_page *page, bool eviction_call) {
 	if (page == NULL || page->mapping == NULL || page->mapping->fl == NULL) return false;
-	else if (!suppl_page_dirty(page)) return true;
+	ASSERT(lock_held_by_current_thread(&page->lock));
+	if (!suppl_page_dirty(page)) return true;
 	else if (!page->mapping->fl_writable) return true;
 	else {
 		if (!set_kpage_if_needed(page, eviction_call)) return false;
@@ -168,9 +171,9 @@ bool suppl_page_load_to_file(struct suppl_page *page, bool eviction_call) {
 		if (((uint32_t)end) > ((uint32_t)file_end))
 			end = file_end;
 		if (start < end) {
-			file_seek(page->mapping->fl, (start - file_start));
+			off_t file_ofs = (start - file_start) + page->mapping->offset;
 			int buffer_size = (end - start);
-			bool rv = (file_write(page->mapping->fl, ((char*)pg_round_down((void*)page->kaddr)) + (start - ((char*)page->vaddr)), buffer_size) == buffer_size);
+			bool rv = (file_write_at(page->mapping->fl, ((char*)pg_round_down((void*)page->kaddr)) + (start - ((char*)page->vaddr)), buffer_size, file_ofs) == buffer_size);
 			if (!eviction_call) register_suppl_page(page);
 			return rv;
 		}
@@ -188,6 +191,10 @@ void suppl_pt_init(struct suppl_pt *pt) {
 	if (!hash_init(&pt->pages_map, pages_map_hash, pages_map_less, NULL))
 		PANIC("HASH INITIALISATION FAILED");
 	pt->owner_thread = NULL;
+	pt->fault_cnt = 0;
+	pt->fault_ticks = 0;
+	pt->evict_cnt = 0;
+	pt->swap_in_cnt = 0;
 }
 
 // Allocates and initializes SPT.
@@ -222,7 +229,6 @@ bool suppl_table_set_page(struct thread *t, void *upage, void *kpage, bool rw) {
 	page->kaddr = ((uint32_t)kpage);
 	page->location = PG_LOCATION_RAM;
 	page->dirty = true;
-	page->accessed = true;
 	pagedir_set_dirty(page->pagedir, (const void*)page->vaddr, true);
 	register_suppl_page(page);
 
@@ -250,7 +256,7 @@ bool suppl_table_set_file_mapping(struct thread *t, void* upage, struct file_map
 
 // Allocates SP (almost exclusively used for stack growth).
 bool suppl_table_alloc_user_page(struct thread *t, void *upage, bool writeable) {
-	void* kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+	void* kpage = get_free_kaddr();
 	if(kpage == NULL) {
 		kpage = evict_and_get_kaddr();
 		if(kpage == NULL) return false;
@@ -6,6 +6,7 @@
 
 #include "lib/kernel/hash.h"
 #include "threads/thread.h"
+#include "threads/synch.h"
 #include "vm/file_mapping.h"
 #include "swap.h"
 #include <list.h>
@@ -27,15 +28,18 @@ struct suppl_page {
     const struct file_mapping *mapping;	// File mapping (NULL if none)
 	enum suppl_page_location location;	// Current location of the page
 	bool dirty;			// True, if page is dirty (variable should never be accessed directly)
-	bool accessed;		// True, if page is accessed (variable should never be accessed directly)
+	struct lock lock;		// Held while the page is brought to RAM or moved out of it (see vm_util.c)
     struct hash_elem hash_elem;	// Element for hash map
-	struct list_elem list_elem;	// Element for the list of evictables
 };
 
 // SPT structure:
 struct suppl_pt {
 	struct thread *owner_thread;	// Owner thread
 	struct hash pages_map;			// Hash map for current thread's PS-s
+	unsigned long long fault_cnt;	// Number of page faults
+	int64_t fault_ticks;			// Timer ticks spent handling page faults
+	unsigned long long evict_cnt;	// Number of evictions, made to get a frame
+	unsigned long long swap_in_cnt;	// Number of pages, read back from swap
 };
 
 // Hash function for SP
@@ -57,12 +61,10 @@ void suppl_page_delete(struct suppl_page *page);
 
 // Returns true, if SP is/ever was dirty.
 bool suppl_page_dirty(struct suppl_page *page);
-// Returns true, if SP is/ever was accessed.
-bool suppl_page_accessed(struct suppl_page *page);
 
-// Loads page from file.
+// Loads page from file (the caller holds the page's lock).
 bool suppl_page_load_from_file(struct suppl_page *page);
-// Loads page to file.
+// Loads page to file (the caller holds the page's lock).
 bool suppl_page_load_to_file(struct suppl_page *page, bool eviction_call);
 
 // Initializes SPT.
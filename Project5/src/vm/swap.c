@@ -10,17 +10,23 @@ static bool swap_initialized = false;
 static struct bitmap *alloc_map = NULL;
 static struct block *swap_block = NULL;
 
+// Next-fit cursor: the search for free swap pages starts right after the last allocated ones, so that pages
+// swapped out one after another end up in sequential runs on the disk.
+static size_t next_fit = 0;
+
+// Lock for the allocation map and the cursor
+static struct lock swap_lock;
+
 // pgsize - 4kb, block_size - 512b
 #define SECTORS_PER_PAGE (PAGE_SIZE / BLOCK_SECTOR_SIZE)
 
-#define START 0
-
 // Initilizes swap block.
 void swap_init(void) {
 	if (!swap_initialized) {
 		swap_block = block_get_role(BLOCK_SWAP);
         alloc_map = bitmap_create(block_size(swap_block) / SECTORS_PER_PAGE);
         ASSERT(alloc_map != NULL && swap_block != NULL);
+		lock_init(&swap_lock);
 		vm_itil_init();
 		swap_initialized = true;
 	}
@@ -28,20 +34,32 @@ void swap_init(void) {
 
 // Finds and returns free swap page.
 swap_page swap_get_page(void) {
-    // Find interval of SECTORS_PER_PAGE consecutive 'false' bits and flip them  
-    swap_page start_sector = bitmap_scan_and_flip(alloc_map, START, 1, false);
-    if (start_sector == BITMAP_ERROR)
-        return SWAP_NO_PAGE;
-    return start_sector;
+	return swap_get_pages(1);
+}
+
+// Finds cnt adjacent free swap pages and returns the first of them (SWAP_NO_PAGE, if there are none).
+swap_page swap_get_pages(size_t cnt) {
+	lock_acquire(&swap_lock);
+	size_t start = bitmap_scan_and_flip(alloc_map, next_fit, cnt, false);
+	if (start == BITMAP_ERROR && next_fit > 0)
+		start = bitmap_scan_and_flip(alloc_map, 0, cnt, false);
+	if (start != BITMAP_ERROR)
+		next_fit = (start + cnt) % bitmap_size(alloc_map);
+	lock_release(&swap_lock);
+	if (start == BITMAP_ERROR)
+		return SWAP_NO_PAGE;
+	return start;
 }
 
 // Releases swap page.
 void swap_free_page(swap_page page) {
+    lock_acquire(&swap_lock);
     // Ensure all needed sectors are marked in bitmap
     if (bitmap_contains(alloc_map, page, 1, false))
         PANIC("Attempting to free non-allocated swap sector %d", (int) page);
 
     bitmap_set_multiple(alloc_map, page, 1, false);
+    lock_release(&swap_lock);
 }
 
 // Loads the content of the addr page into given swap page.
@@ -51,13 +69,7 @@ void swap_load_page_to_ram(swap_page page, void *addr) {
     if (bitmap_contains(alloc_map, page, 1, false))
         PANIC("Attempting to load non-allocated swap sector %d", (int) page);
 
-    char *addr_for_cur_sector = addr;
-	page *= SECTORS_PER_PAGE;
-    int i;
-    for (i = 0; i < SECTORS_PER_PAGE; i++){
-        block_read(swap_block, page + i, addr_for_cur_sector);    
-        addr_for_cur_sector += BLOCK_SECTOR_SIZE;
-    }
+    block_read_multiple(swap_block, page * SECTORS_PER_PAGE, SECTORS_PER_PAGE, addr);
 }
 
 // Loads the content of the swap page to physical memory.
@@ -67,12 +79,5 @@ void swap_load_page_to_swap(swap_page page, void *addr) {
     if (bitmap_contains(alloc_map, page, 1, false))
         PANIC("Attempting to write to non-allocated swap sector %d", (int) page);
 
-    char *addr_for_cur_sector = addr;
-	page *= SECTORS_PER_PAGE;
-    int i;
-    for (i = 0; i < SECTORS_PER_PAGE; i++){
-        block_write(swap_block, page + i, addr_for_cur_sector);
-        addr_for_cur_sector += BLOCK_SECTOR_SIZE;
-    }
+    block_write_multiple(swap_block, page * SECTORS_PER_PAGE, SECTORS_PER_PAGE, addr);
 }
-
@@ -1,5 +1,6 @@
 #ifndef SWAP_H
 #define SWAP_H
+#include <stddef.h>
 
 typedef long long swap_page; // Swap page identifier
 #define SWAP_NO_PAGE -1 // Error code for swap page(returned if none found)
@@ -10,6 +11,9 @@ void swap_init(void);
 // Finds and returns free swap page.
 swap_page swap_get_page(void);
 
+// Finds cnt adjacent free swap pages and returns the first of them (SWAP_NO_PAGE, if there are none).
+swap_page swap_get_pages(size_t cnt);
+
 // Releases swap page.
 void swap_free_page(swap_page page);
 
@@ -1,48 +1,168 @@
 #include "vm_util.h"
-#include "threads/vaddr.h"
+#include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "userprog/pagedir.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "frame.h"
+#include <stdio.h>
 
 #define VM_UTIL_MAX_STACK_OFFSET 128
 #define VM_MAX_STACK_SIZE (1024 * 1024 * 8)
 #define VM_STACK_END (PHYS_BASE - VM_MAX_STACK_SIZE)
 
-// List of the pages that are in RAM
-static struct list page_list;
+// Age of a page, that was accessed during the last sweep of the Clock hand
+#define AGE_ACCESSED 0x80
 
-// The "hand" of our Clock algorithm
-static struct list_elem *page_elem;
+// Most pages, that are written to adjacent swap pages together
+#define SWAP_CLUSTER_PAGES 8
 
-// Lock for synchronizing eviction
-static struct semaphore eviction_lock;
+// Most neighbours read around a page, that's swapped in (after it first, then before it). They're read one
+// by one, while the faulting process waits, so the window is kept small.
+#define SWAP_READAROUND_PAGES 3
+
+// The "hand" of our Clock algorithm (number of the frame it points to)
+static size_t clock_hand;
+
+/* Locking: every page has its own lock, that's held while the page is brought to RAM or moved out of it,
+	including the disk I/O, so a fault on a page, that's being evicted, waits until it's written out. Only the
+	owner process waits for the locks of its pages; evictions just try to take them, and skip busy pages.
+	The pages of one file mapping share only its struct file, which is read and written at explicit
+	offsets (never through its position), so they don't need to be serialised with each other either.
+	frame_lock guards the frame table, the clock hand and the page directories. It's only held for short
+	updates (never across disk I/O), and nobody waits for a page lock while holding it. */
+static struct lock frame_lock;
+
+// Paging statistics (of all processes)
+static unsigned long long evict_cnt;
+static unsigned long long swap_in_cnt;
+static unsigned long long swap_prefetch_cnt;
+
+// True, if the paging statistics of every process should be printed, when it exits
+static bool print_process_stats = false;
+
+/* Page-out daemon: when the number of free frames drops below pageout_low, it's woken up, and it
+	evicts pages until there are pageout_high free frames again. That way, page faults usually find a
+	free frame, and only the daemon waits for the pages to be written out. */
+
+// Watermarks, in 64ths of the user pool
+#define PAGEOUT_LOW_64THS 2
+#define PAGEOUT_HIGH_64THS 4
+
+// Watermarks (numbers of free frames)
+static size_t pageout_low;
+static size_t pageout_high;
+
+// Wakes up the page-out daemon
+static struct semaphore pageout_wanted;
+// True, if the daemon was woken up, but it's not done yet
+static bool pageout_pending;
+
+static void pageout_daemon(void *aux);
 
 // Initilizes the data structures needed for the VM utilities to function properly.
 void vm_itil_init(void) {
-	list_init(&page_list);
-	sema_init(&eviction_lock, 1);
-	page_elem = NULL;
+	frame_table_init();
+	lock_init(&frame_lock);
+	clock_hand = 0;
+
+	size_t frame_cnt = frame_table_size();
+	pageout_low = frame_cnt * PAGEOUT_LOW_64THS / 64;
+	if (pageout_low < 1) pageout_low = 1;
+	pageout_high = frame_cnt * PAGEOUT_HIGH_64THS / 64;
+	if (pageout_high <= pageout_low) pageout_high = pageout_low + 1;
+	sema_init(&pageout_wanted, 0);
+	pageout_pending = false;
+	thread_create("page-out", PRI_DEFAULT, pageout_daemon, NULL);
 }
 
 // Removes the given page from the list of evictables.
 void undo_suppl_page_registration(struct suppl_page *page) {
-	sema_down(&eviction_lock);
-	if (&page->list_elem == page_elem) {
-		page_elem = list_next(page_elem);
-		if (page_elem == list_end(&page_list))
-			page_elem = NULL;
+	lock_acquire(&frame_lock);
+	if (page->kaddr != 0) {
+		struct frame *frame = frame_lookup((void*)page->kaddr);
+		if (frame->page == page)
+			frame->page = NULL;
 	}
-	if (page->kaddr != 0)
-		list_remove(&page->list_elem);
-	sema_up(&eviction_lock);
+	lock_release(&frame_lock);
 }
 // Adds given page to evictables.
 void register_suppl_page(struct suppl_page *page) {
 	if (page->kaddr != 0) {
-		sema_down(&eviction_lock);
-		list_push_front(&page_list, &page->list_elem);
-		sema_up(&eviction_lock);
+		lock_acquire(&frame_lock);
+		struct frame *frame = frame_lookup((void*)page->kaddr);
+		frame->page = page;
+		frame->age = AGE_ACCESSED;
+		lock_release(&frame_lock);
+	}
+}
+
+// Brings the page to RAM, if it's not there (the caller holds the page's lock).
+static bool page_in_locked(struct suppl_page *page) {
+	if (page->kaddr != 0) return true;
+	if (page->location == PG_LOCATION_SWAP)
+		return restore_page_from_swap(page, true);
+	if (page->location == PG_LOCATION_FILE)
+		return suppl_page_load_from_file(page);
+	return false;
+}
+
+// Brings the page of the current process to RAM, waiting for it first, if it's being evicted.
+bool fault_in_page(struct suppl_page *page) {
+	lock_acquire(&page->lock);
+	bool rv = page_in_locked(page);
+	lock_release(&page->lock);
+	return rv;
+}
+
+// Pins the page of the current process at UPAGE, bringing it to RAM first, if needed.
+static bool pin_user_page(void *upage) {
+	struct suppl_page *page = suppl_pt_lookup(thread_current()->suppl_page_table, upage);
+	if (page == NULL) return false;
+	lock_acquire(&page->lock);
+	bool rv = page_in_locked(page);
+	if (rv) {
+		lock_acquire(&frame_lock);
+		frame_lookup((void*)page->kaddr)->pin_cnt++;
+		lock_release(&frame_lock);
 	}
+	lock_release(&page->lock);
+	return rv;
+}
+
+// Unpins the page of the current process at UPAGE.
+static void unpin_user_page(void *upage) {
+	struct suppl_page *page = suppl_pt_lookup(thread_current()->suppl_page_table, upage);
+	ASSERT(page != NULL && page->kaddr != 0);
+	lock_acquire(&frame_lock);
+	struct frame *frame = frame_lookup((void*)page->kaddr);
+	ASSERT(frame->pin_cnt > 0);
+	frame->pin_cnt--;
+	lock_release(&frame_lock);
+}
+
+// Brings the pages of the user buffer to RAM and pins them there, so that the kernel can access
+// the buffer without page faults. Returns false (with nothing pinned), if it's not possible.
+bool pin_user_buffer(const void *buffer, size_t size) {
+	char *start = pg_round_down(buffer);
+	char *end = ((char*)buffer) + size;
+	char *upage;
+	for (upage = start; upage < end; upage += PAGE_SIZE)
+		if (!pin_user_page(upage)) {
+			while (upage > start) {
+				upage -= PAGE_SIZE;
+				unpin_user_page(upage);
+			}
+			return false;
+		}
+	return true;
+}
+// Unpins the pages of the user buffer, pinned by pin_user_buffer.
+void unpin_user_buffer(const void *buffer, size_t size) {
+	char *end = ((char*)buffer) + size;
+	char *upage;
+	for (upage = pg_round_down(buffer); upage < end; upage += PAGE_SIZE)
+		unpin_user_page(upage);
 }
 
 // Returns true, if the address can be a part of stack at some point in time.
@@ -55,167 +175,330 @@ bool stack_grow_needed(const void *addr, const void *esp) {
 	return (addr_in_stack_range(addr) && ((const char*)addr) >= ((const char*)esp - VM_UTIL_MAX_STACK_OFFSET));
 }
 
+/* Page replacement: aging Clock algorithm.
 
+	As the hand sweeps over the frame table, it samples and clears the accessed bit of every page it
+	passes, and shifts it into the age of the frame. A page belongs to the working set of its process,
+	if it was accessed within the last working_set_sweeps sweeps of the hand; the first page found
+	outside of its working set is evicted. If a whole sweep finds none, the oldest page is evicted. */
 
+// Number of sweeps of the hand, that a page stays in the working set after it's accessed (1 to 8)
+static unsigned working_set_sweeps = VM_DEFAULT_WORKING_SET_SWEEPS;
 
-/* Some macros for Clock algorithm; they look ugly, but reduced the code repetition to minimum. */
-
-// Gets supplemental page from hand pointer
-#define EVICTION_GET_PAGE struct suppl_page *page = list_entry(page_elem, struct suppl_page, list_elem); ASSERT(page != NULL)
-
-// Gets information about page and stores it in two booleans: modified and referenced.
-#define EVICTION_GET_PAGE_TYPE bool modified = suppl_page_dirty(page); bool referenced = suppl_page_accessed(page)
-
-// Cleans the page, so that it's no longer mapped on physical address.
-#define EVICTION_EVICT_PAGE \
-	void *page_kaddr = (void*)page->kaddr; \
-	page->kaddr = 0; \
-	pagedir_clear_page(page->pagedir, (void*)page->vaddr); \
-	palloc_free_page(page_kaddr); \
-	page_elem = list_next(page_elem); \
-	if (page_elem == list_end(&page_list)) \
-		page_elem = NULL; \
-	list_remove(&page->list_elem); \
-	/*printf("page evicted (addr: %u)\n", ((uint32_t)page->vaddr / PAGE_SIZE)); */ \
-	sema_up(&eviction_lock); \
-	return true
-
-// Moves the content of the page to swap.
-#define EVICTION_MOVE_TO_SWAP \
-	swap_page spage = swap_get_page(); \
-	if (spage == SWAP_NO_PAGE){ \
-		sema_up(&eviction_lock); \
-		return false; \
-	} \
-	swap_load_page_to_swap(spage, (void*)page->kaddr); \
-	page->saddr = spage; \
-	page->location = PG_LOCATION_SWAP; \
-	/*printf("page->saddr = %d; page->vaddr = %d\n", (int)page->saddr, (int)page->vaddr); */
-
-// Evicts unmodified page.
-#define EVICTION_EVICT_NOT_MODIFIED \
-	/*printf("NOT MODIFIED....\n"); */\
-	if (page->mapping != NULL && page->mapping->writable) \
-		page->location = PG_LOCATION_FILE; \
-	else{ \
-		EVICTION_MOVE_TO_SWAP; \
-	} \
-	EVICTION_EVICT_PAGE
-
-// Evicts a modified page.
-#define EVICTION_EVICT_MODIFIED \
-	/*printf("MODIFIED....\n");  */\
-	if (page->mapping != NULL && page->mapping->fl_writable && page->mapping->writable) { \
-		suppl_page_load_to_file(page, true); \
-		page->location = PG_LOCATION_FILE; \
-	} \
-	else { \
-		EVICTION_MOVE_TO_SWAP; \
-	} \
-	EVICTION_EVICT_PAGE
-
-// Moves "hand" of our Clock algorithm
-#define EVICTION_MOVE_TO_NEXT page_elem = list_next(page_elem); if (page_elem == list_end(&page_list)) page_elem = list_begin(&page_list); if (page_elem == terminal) break
-
-// Evicts a page using Clock algorithm
-static bool evict_page(void) {
-	sema_down(&eviction_lock);
-	if (list_empty(&page_list)) {
-		sema_up(&eviction_lock);
-		return false;
+// Sets the number of sweeps of the hand, that a page stays in the working set after it's accessed.
+void vm_set_working_set_sweeps(unsigned sweeps) {
+	ASSERT(sweeps >= 1 && sweeps <= 8);
+	working_set_sweeps = sweeps;
+}
+
+// Shifts the accessed bit of the page in the frame into the frame's age and clears it.
+static void frame_age(struct frame *frame) {
+	struct suppl_page *page = frame->page;
+	frame->age >>= 1;
+	if (pagedir_is_accessed(page->pagedir, (const void*)page->vaddr)) {
+		frame->age |= AGE_ACCESSED;
+		pagedir_set_accessed(page->pagedir, (const void*)page->vaddr, false);
 	}
-	//PANIC("########################## WILLING TO EVICT ###################################\n");
-	if (page_elem == NULL || page_elem == list_end(&page_list))
-		page_elem = list_begin(&page_list);
-	struct list_elem *terminal = page_elem;
-	while (true) {
-		EVICTION_GET_PAGE;
-		EVICTION_GET_PAGE_TYPE;
-		if ((!referenced) && (!modified)) {
-			//printf("############### THROWING THE PAGE AWAY ###########################\n");
-			EVICTION_EVICT_NOT_MODIFIED;
-		}
-		EVICTION_MOVE_TO_NEXT;
+}
+
+// Returns true, if the page in the frame was accessed within the last working_set_sweeps sweeps.
+static bool frame_in_working_set(const struct frame *frame) {
+	uint8_t window = (uint8_t)(0xff << (8 - working_set_sweeps));
+	return ((frame->age & window) != 0);
+}
+
+// Returns true, if the page goes to swap (and not to its file), when it's evicted.
+static bool page_swap_bound(struct suppl_page *page) {
+	const struct file_mapping *mapping = page->mapping;
+	return !(mapping != NULL && mapping->writable && ((!suppl_page_dirty(page)) || mapping->fl_writable));
+}
+
+// Takes the lock of the page in the frame, if it's free (never waits for it).
+static bool frame_try_lock_page(struct frame *frame) {
+	struct lock *lock = &frame->page->lock;
+	return (!lock_held_by_current_thread(lock) && lock_try_acquire(lock));
+}
+
+// Prepares the frame (with its page locked) for the eviction: samples the dirty bit of the page, unmaps it,
+// so that its process faults (and waits for the page lock), if it touches it, and pins the frame, until
+// the page is written out.
+static void frame_detach(struct frame *frame) {
+	struct suppl_page *page = frame->page;
+	suppl_page_dirty(page);
+	pagedir_clear_page(page->pagedir, (void*)page->vaddr);
+	frame->pin_cnt++;
+}
+
+// Frees the detached frame, once its page is written out to LOCATION, and releases the page's lock.
+static void release_frame(struct frame *frame, enum suppl_page_location location) {
+	struct suppl_page *page = frame->page;
+	lock_acquire(&frame_lock);
+	page->kaddr = 0;
+	page->location = location;
+	frame->page = NULL;
+	frame->pin_cnt--;
+	evict_cnt++;
+	lock_release(&frame_lock);
+	palloc_free_page(frame_kaddr(frame));
+	struct suppl_pt *pt = thread_current()->suppl_page_table;
+	if (pt != NULL) pt->evict_cnt++;
+	lock_release(&page->lock);
+}
+
+// Returns the frame of the page DISTANCE pages away from the given one, if it can go to swap together with it
+// (it's evictable, outside of its working set, bound for swap and not busy), with its page locked, or NULL.
+static struct frame *swap_cluster_neighbour(const struct suppl_page *page, int distance) {
+	const char *vaddr = ((const char*)page->vaddr) + distance * PAGE_SIZE;
+	if (vaddr == NULL || !is_user_vaddr(vaddr)) return NULL;
+	void *kaddr = pagedir_get_page(page->pagedir, vaddr);
+	if (kaddr == NULL) return NULL;
+	struct frame *frame = frame_lookup(kaddr);
+	if (!frame_evictable(frame) || frame_in_working_set(frame)) return NULL;
+	if (pagedir_is_accessed(page->pagedir, vaddr) || !page_swap_bound(frame->page)) return NULL;
+	if (!frame_try_lock_page(frame)) return NULL;
+	return frame;
+}
+
+// Collects the frames of the victim and of the virtual pages around it, that can go to swap together with it,
+// into CLUSTER, ordered by virtual address, and locks their pages. Returns their number.
+static size_t swap_cluster(struct frame *victim, struct frame **cluster) {
+	const struct suppl_page *page = victim->page;
+	struct frame *after[SWAP_CLUSTER_PAGES], *before[SWAP_CLUSTER_PAGES];
+	size_t after_cnt = 0, before_cnt = 0;
+	while (1 + after_cnt < SWAP_CLUSTER_PAGES
+		&& (after[after_cnt] = swap_cluster_neighbour(page, (int)after_cnt + 1)) != NULL)
+		after_cnt++;
+	while (1 + after_cnt + before_cnt < SWAP_CLUSTER_PAGES
+		&& (before[before_cnt] = swap_cluster_neighbour(page, -(int)before_cnt - 1)) != NULL)
+		before_cnt++;
+	size_t cnt = 0, i;
+	while (before_cnt > 0)
+		cluster[cnt++] = before[--before_cnt];
+	cluster[cnt++] = victim;
+	for (i = 0; i < after_cnt; i++)
+		cluster[cnt++] = after[i];
+	return cnt;
+}
+
+// Chooses the pages, that are evicted together with the victim, into CLUSTER, and the swap pages for them
+// (*SPAGE stays SWAP_NO_PAGE, if the victim goes to its file). Returns their number, or 0 (with the victim's
+// page unlocked), if there is no room in swap.
+static size_t eviction_cluster(struct frame *victim, struct frame **cluster, swap_page *spage) {
+	cluster[0] = victim;
+	if (!page_swap_bound(victim->page)) return 1;
+	size_t cnt = swap_cluster(victim, cluster);
+	*spage = swap_get_pages(cnt);
+	if (*spage == SWAP_NO_PAGE && cnt > 1) {
+		size_t i;
+		for (i = 0; i < cnt; i++)
+			if (cluster[i] != victim) lock_release(&cluster[i]->page->lock);
+		cnt = 1;
+		cluster[0] = victim;
+		*spage = swap_get_pages(cnt);
+	}
+	if (*spage == SWAP_NO_PAGE) {
+		lock_release(&victim->page->lock);
+		return 0;
+	}
+	return cnt;
+}
+
+// Moves the content of the page in the detached frame to its file (if SADDR is SWAP_NO_PAGE) or to swap page
+// SADDR, and frees the frame.
+static void evict_frame(struct frame *frame, swap_page saddr) {
+	struct suppl_page *page = frame->page;
+	if (saddr == SWAP_NO_PAGE) {
+		if (suppl_page_dirty(page)) suppl_page_load_to_file(page, true);
+		release_frame(frame, PG_LOCATION_FILE);
+	} else {
+		swap_load_page_to_swap(saddr, (void*)page->kaddr);
+		page->saddr = saddr;
+		release_frame(frame, PG_LOCATION_SWAP);
 	}
-	while (true){
-		EVICTION_GET_PAGE;
-		EVICTION_GET_PAGE_TYPE;
-		if ((!referenced) && (modified)) {
-			//PANIC("############### EVICTING THE PAGE ###########################\n");
-			EVICTION_EVICT_MODIFIED;
+}
+
+// Sweeps the Clock hand over the frame table, until it finds a victim, whose page it can lock; returns NULL,
+// if there is none (the caller holds frame_lock).
+static struct frame *clock_select(void) {
+	size_t frame_cnt = frame_table_size();
+	int sweep;
+	// If the oldest page is busy, the second sweep looks again (with all the pages a sweep older).
+	for (sweep = 0; sweep < 2; sweep++) {
+		struct frame *oldest = NULL;
+		size_t i;
+		for (i = 0; i < frame_cnt; i++) {
+			struct frame *frame = frame_at(clock_hand);
+			clock_hand = (clock_hand + 1) % frame_cnt;
+			if (!frame_evictable(frame)) continue;
+			frame_age(frame);
+			if (!frame_in_working_set(frame) && frame_try_lock_page(frame))
+				return frame;
+			if (oldest == NULL || frame->age < oldest->age)
+				oldest = frame;
 		}
-		EVICTION_MOVE_TO_NEXT;
+		if (oldest == NULL) return NULL;
+		if (frame_try_lock_page(oldest)) return oldest;
+	}
+	return NULL;
+}
+
+// Evicts a page using Clock algorithm. The victims are chosen under frame_lock, but they are written out with
+// only their own locks held, so evictions and faults of other processes go on meanwhile.
+static bool evict_page(void) {
+	struct frame *cluster[SWAP_CLUSTER_PAGES];
+	swap_page spage = SWAP_NO_PAGE;
+	size_t cnt = 0, i;
+	lock_acquire(&frame_lock);
+	struct frame *victim = clock_select();
+	if (victim != NULL)
+		cnt = eviction_cluster(victim, cluster, &spage);
+	for (i = 0; i < cnt; i++)
+		frame_detach(cluster[i]);
+	lock_release(&frame_lock);
+	for (i = 0; i < cnt; i++)
+		evict_frame(cluster[i], ((spage == SWAP_NO_PAGE) ? SWAP_NO_PAGE : (spage + i)));
+	return (cnt > 0);
+}
+
+// Wakes up the page-out daemon, if the number of free frames is below the low watermark.
+static void pageout_wake(void) {
+	if (!pageout_pending && palloc_user_free_cnt() < pageout_low) {
+		pageout_pending = true;
+		sema_up(&pageout_wanted);
 	}
+}
+
+// Evicts pages, until there are pageout_high free frames, whenever it's woken up.
+static void pageout_daemon(void *aux UNUSED) {
 	while (true) {
-		EVICTION_GET_PAGE;
-		bool modified = suppl_page_dirty(page);
-		if ((!modified)) {
-			//PANIC("############### THROWING THE PAGE AWAY ###########################\n");
-			EVICTION_EVICT_NOT_MODIFIED;
-		}
-		EVICTION_MOVE_TO_NEXT;
+		sema_down(&pageout_wanted);
+		while (palloc_user_free_cnt() < pageout_high)
+			if (!evict_page()) break;
+		pageout_pending = false;
 	}
-	EVICTION_GET_PAGE;
-	//PANIC("############### EVICTING THE PAGE ###########################\n");
-	EVICTION_EVICT_MODIFIED;
 }
 
-// Undefs for the macros:
-#undef EVICTION_GET_PAGE
-#undef EVICTION_GET_PAGE_TYPE
-#undef EVICTION_MOVE_TO_SWAP
-#undef EVICTION_EVICT_PAGE
-#undef EVICTION_EVICT_NOT_MODIFIED
-#undef EVICTION_MOVE_TO_NEXT
+// Allocates a zeroed kernel page from the user pool, without evicting (NULL, if there are no free frames).
+void *get_free_kaddr(void) {
+	void *kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+	pageout_wake();
+	return kpage;
+}
 
 // Evicts and allocates a kernel page.
 void *evict_and_get_kaddr(void) {
-	if (!evict_page()) return NULL;
-	void* kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+	// Faults of other processes may take the freed frame first; then we just evict again.
+	void *kpage = NULL;
+	while (kpage == NULL && evict_page())
+		kpage = get_free_kaddr();
 	return kpage;
 }
 
 
-// Restores given page from swap.
+// Reads the page from swap into a free frame, and maps it (the caller holds the page's lock). Nothing is read,
+// once the free frames are down to the low watermark: they're the reserve for faults.
+static bool swap_prefetch_page(struct suppl_page *page) {
+	if (palloc_user_free_cnt() <= pageout_low) return false;
+	void *kpage = palloc_get_page(PAL_USER);
+	pageout_wake();
+	if (kpage == NULL) return false;
+	swap_load_page_to_ram(page->saddr, kpage);
+	lock_acquire(&frame_lock);
+	bool mapped = pagedir_set_page(page->pagedir, (void*)page->vaddr, kpage, true);
+	if (mapped) {
+		swap_free_page(page->saddr);
+		page->saddr = SWAP_NO_PAGE;
+		page->kaddr = ((uint32_t)kpage);
+		page->location = PG_LOCATION_RAM;
+		// Not accessed yet, so it's the first to go, if it's not needed after all.
+		struct frame *frame = frame_lookup(kpage);
+		frame->page = page;
+		frame->age = 0;
+		swap_prefetch_cnt++;
+	}
+	lock_release(&frame_lock);
+	if (!mapped) palloc_free_page(kpage);
+	return mapped;
+}
+
+// Brings the page DISTANCE pages away from the given one to RAM, if it's in the swap page DISTANCE pages away
+// from SADDR (so it was most likely swapped out together with it), it's not busy and there is a free frame for it.
+static bool swap_prefetch(const struct suppl_page *page, swap_page saddr, int distance) {
+	struct suppl_pt *pt = thread_current()->suppl_page_table;
+	char *vaddr = ((char*)page->vaddr) + distance * PAGE_SIZE;
+	if (pt == NULL || vaddr == NULL || !is_user_vaddr(vaddr)) return false;
+	struct suppl_page *next = suppl_pt_lookup(pt, vaddr);
+	if (next == NULL || !lock_try_acquire(&next->lock)) return false;
+	bool rv = (next->location == PG_LOCATION_SWAP && next->saddr == saddr + distance && swap_prefetch_page(next));
+	lock_release(&next->lock);
+	return rv;
+}
+
+// Restores given page from swap (the caller holds the page's lock).
 bool restore_page_from_swap(struct suppl_page *page, bool reg_page) {
-	sema_down(&eviction_lock);
+	ASSERT(lock_held_by_current_thread(&page->lock));
 	ASSERT(page->location == PG_LOCATION_SWAP && page->saddr != SWAP_NO_PAGE);
-	void* kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+	void* kpage = get_free_kaddr();
 	if (kpage == NULL) {
-		sema_up(&eviction_lock);
 		kpage = evict_and_get_kaddr();
-		sema_down(&eviction_lock);
-		if (kpage == NULL) {
-			sema_up(&eviction_lock);
-			return false;
-		}
+		if (kpage == NULL) return false;
 	}
-	if (!pagedir_set_page(page->pagedir, (void*)page->vaddr, kpage, true)) {
+	swap_page saddr = page->saddr;
+	swap_load_page_to_ram(saddr, kpage);
+	lock_acquire(&frame_lock);
+	bool mapped = pagedir_set_page(page->pagedir, (void*)page->vaddr, kpage, true);
+	if (mapped) swap_in_cnt++;
+	lock_release(&frame_lock);
+	if (!mapped) {
 		palloc_free_page(kpage);
-		sema_up(&eviction_lock);
 		return false;
 	}
-	swap_load_page_to_ram(page->saddr, (void*)page->vaddr);
-	swap_free_page(page->saddr);
+	swap_free_page(saddr);
 	page->saddr = SWAP_NO_PAGE;
 	page->kaddr = ((uint32_t)kpage);
 	page->location = PG_LOCATION_RAM;
-	sema_up(&eviction_lock);
+	struct suppl_pt *pt = thread_current()->suppl_page_table;
+	if (pt != NULL) pt->swap_in_cnt++;
+	// Read around: the neighbours, swapped out together with the page, are likely to be needed soon.
+	int budget = SWAP_READAROUND_PAGES, distance;
+	for (distance = 1; budget > 0 && swap_prefetch(page, saddr, distance); distance++)
+		budget--;
+	for (distance = -1; budget > 0 && swap_prefetch(page, saddr, distance); distance--)
+		budget--;
 	if(reg_page)
 		register_suppl_page(page);
 	return true;
 }
 
 // Synchronised version of pagedir_set_page
-bool pagedir_set_page_synch(uint32_t *pd, void *upage, void *kpage, bool rw) {
-	sema_down(&eviction_lock);
-	bool rv = pagedir_set_page(pd, upage, kpage, rw);
-	sema_up(&eviction_lock);
-	return rv;
-}
-// Synchronised version of pagedir_clear_page
+bool pagedir_set_page_synch(uint32_t *pd, void *upage, void *kpage, bool rw) {
+	lock_acquire(&frame_lock);
+	bool rv = pagedir_set_page(pd, upage, kpage, rw);
+	lock_release(&frame_lock);
+	return rv;
+}
+// Synchronised version of pagedir_clear_page
 void pagedir_clear_page_synch(uint32_t *pd, void *upage) {
-	sema_down(&eviction_lock);
+	lock_acquire(&frame_lock);
 	pagedir_clear_page(pd, upage);
-	sema_up(&eviction_lock);
+	lock_release(&frame_lock);
+}
+
+// Makes every process print its paging statistics, when it exits.
+void vm_enable_process_stats(void) {
+	print_process_stats = true;
 }
+
+// Prints the paging statistics of the process, if enabled.
+void vm_print_process_stats(const struct thread *t) {
+	const struct suppl_pt *pt = t->suppl_page_table;
+	if (print_process_stats && pt != NULL && t->executable_name != NULL)
+		printf("%s: %llu page faults in %lld ticks, %llu evictions, %llu swap-ins\n",
+			t->executable_name, pt->fault_cnt, pt->fault_ticks, pt->evict_cnt, pt->swap_in_cnt);
+}
+
+// Prints the paging statistics of all processes.
+void vm_print_stats(void) {
+	printf("VM: %llu evictions, %llu swap-ins, %llu pages read ahead\n", evict_cnt, swap_in_cnt, swap_prefetch_cnt);
+}
+
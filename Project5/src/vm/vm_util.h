@@ -6,25 +6,48 @@
 // Initilizes the data structures needed for the VM utilities to function properly.
 void vm_itil_init(void);
 
+// Default number of sweeps of the Clock hand, that a page stays in the working set after it's accessed.
+#define VM_DEFAULT_WORKING_SET_SWEEPS 2
+// Sets the number of sweeps of the Clock hand, that a page stays in the working set after it's accessed (1 to 8).
+void vm_set_working_set_sweeps(unsigned sweeps);
+
 // Removes the given page from the list of evictables.
 void undo_suppl_page_registration(struct suppl_page *page);
 // Adds given page to evictables.
 void register_suppl_page(struct suppl_page *page);
 
+// Brings the page of the current process to RAM, waiting for it first, if it's being evicted.
+bool fault_in_page(struct suppl_page *page);
+
+// Brings the pages of the user buffer to RAM and pins them there, so that the kernel can access
+// the buffer without page faults. Returns false (with nothing pinned), if it's not possible.
+bool pin_user_buffer(const void *buffer, size_t size);
+// Unpins the pages of the user buffer, pinned by pin_user_buffer.
+void unpin_user_buffer(const void *buffer, size_t size);
+
 // Returns true, if the address can be a part of stack at some point in time.
 bool addr_in_stack_range(const void *addr);
 
 // Returns true, if stack growth is reasonable, if page faulted on the given address.
 bool stack_grow_needed(const void *addr, const void *esp);
 
+// Allocates a zeroed kernel page from the user pool, without evicting (NULL, if there are no free frames).
+void *get_free_kaddr(void);
 // Evicts and allocates a kernel page.
 void *evict_and_get_kaddr(void);
-// Restores given page from swap.
+// Restores given page from swap (the caller holds the page's lock).
 bool restore_page_from_swap(struct suppl_page *page, bool reg_page);
 
 // Synchronised version of pagedir_set_page
-bool pagedir_set_page_synch(uint32_t *pd, void *upage, void *kpage, bool rw);
-// Synchronised version of pagedir_clear_page
+bool pagedir_set_page_synch(uint32_t *pd, void *upage, void *kpage, bool rw);
+// Synchronised version of pagedir_clear_page
 void pagedir_clear_page_synch(uint32_t *pd, void *upage);
 
-#endif
\ No newline at end of file
+// Makes every process print its paging statistics, when it exits.
+void vm_enable_process_stats(void);
+// Prints the paging statistics of the process, if enabled.
+void vm_print_process_stats(const struct thread *t);
+// Prints the paging statistics of all processes.
+void vm_print_stats(void);
+
+#endif
\ No newline at end of file